@@ -100,6 +100,23 @@ SRes SzAr_DecodeFolder(const CSzAr *p, UInt32 folderIndex,
     Byte *outBuffer, size_t outSize,
     ISzAlloc *allocMain);
 
+/* Byte range of a folder's output with its expected CRC.
+   SzAr_DecodeFolder2 checks it while the output is still hot in cache
+   (branch-converted folders are converted and checksummed slice by slice). */
+
+typedef struct
+{
+  size_t Offset;
+  size_t Size;
+  UInt32 Crc;
+} CSzCrcRange;
+
+SRes SzAr_DecodeFolder2(const CSzAr *p, UInt32 folderIndex,
+    ILookInStream *stream, UInt64 startPos,
+    Byte *outBuffer, size_t outSize,
+    const CSzCrcRange *check,
+    ISzAlloc *allocMain);
+
 typedef struct
 {
   CSzAr db;
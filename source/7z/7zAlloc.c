@@ -76,3 +76,162 @@ void SzFreeTemp(void *p, void *address)
   #endif
   free(address);
 }
+
+
+/* ---------- Arena allocator ---------- */
+
+struct _CSzArenaChunk
+{
+  CSzArenaChunk *next;
+  size_t size;
+};
+
+typedef union
+{
+  struct
+  {
+    size_t size;   /* total block size, header included */
+    size_t large;
+  } h;
+  UInt64 align;
+} CSzArenaHeader;
+
+#define SZ_ARENA_ALIGN(size) (((size) + 7) & ~(size_t)7)
+#define SZ_ARENA_CHUNK_HEADER SZ_ARENA_ALIGN(sizeof(CSzArenaChunk))
+#define SZ_ARENA_CHUNK_DATA(c) ((Byte *)(c) + SZ_ARENA_CHUNK_HEADER)
+
+static void SzArena_Used(CSzArena *p, size_t size)
+{
+  p->used += size;
+  if (p->peak < p->used)
+    p->peak = p->used;
+  if (p->total)
+  {
+    p->total->used += size;
+    if (p->total->peak < p->total->used)
+      p->total->peak = p->total->used;
+  }
+}
+
+static void SzArena_Released(CSzArena *p, size_t size)
+{
+  p->used -= size;
+  if (p->total)
+    p->total->used -= size;
+}
+
+static void *SzArena_Alloc(void *pp, size_t size)
+{
+  CSzArena *p = (CSzArena *)pp;
+  CSzArenaHeader *h;
+  size_t total;
+
+  if (size == 0)
+    return 0;
+  if (size > ((size_t)0 - sizeof(CSzArenaHeader) - 8))
+    return 0;
+  total = SZ_ARENA_ALIGN(size + sizeof(CSzArenaHeader));
+
+  if (total > SZ_ARENA_LARGE_SIZE)
+  {
+    h = (CSzArenaHeader *)malloc(total);
+    if (!h)
+      return 0;
+    h->h.size = total;
+    h->h.large = 1;
+    p->largeUsed += total;
+    p->numLargeAllocs++;
+  }
+  else
+  {
+    if (!p->cur || p->pos + total > p->cur->size)
+    {
+      CSzArenaChunk *c = p->cur ? p->cur->next : p->chunks;
+      if (!c)
+      {
+        c = (CSzArenaChunk *)malloc(SZ_ARENA_CHUNK_HEADER + SZ_ARENA_CHUNK_SIZE);
+        if (!c)
+          return 0;
+        c->next = NULL;
+        c->size = SZ_ARENA_CHUNK_SIZE;
+        if (p->cur)
+          p->cur->next = c;
+        else
+          p->chunks = c;
+        p->reserved += SZ_ARENA_CHUNK_SIZE;
+      }
+      /* the tail of the previous chunk is counted as used until reset */
+      if (p->cur)
+        SzArena_Used(p, p->cur->size - p->pos);
+      p->cur = c;
+      p->pos = 0;
+    }
+    h = (CSzArenaHeader *)(void *)(SZ_ARENA_CHUNK_DATA(p->cur) + p->pos);
+    h->h.size = total;
+    h->h.large = 0;
+    p->pos += total;
+  }
+
+  p->numAllocs++;
+  SzArena_Used(p, total);
+  return h + 1;
+}
+
+static void SzArena_FreeBlock(void *pp, void *address)
+{
+  CSzArena *p = (CSzArena *)pp;
+  CSzArenaHeader *h;
+  if (!address)
+    return;
+  h = (CSzArenaHeader *)address - 1;
+  if (h->h.large)
+  {
+    p->largeUsed -= h->h.size;
+    SzArena_Released(p, h->h.size);
+    free(h);
+  }
+  else if (p->cur && (Byte *)h + h->h.size == SZ_ARENA_CHUNK_DATA(p->cur) + p->pos)
+  {
+    p->pos -= h->h.size;
+    SzArena_Released(p, h->h.size);
+  }
+}
+
+void SzArena_Init(CSzArena *p)
+{
+  p->alloc.Alloc = SzArena_Alloc;
+  p->alloc.Free = SzArena_FreeBlock;
+  p->chunks = NULL;
+  p->cur = NULL;
+  p->pos = 0;
+  p->used = 0;
+  p->largeUsed = 0;
+  p->peak = 0;
+  p->reserved = 0;
+  p->numAllocs = 0;
+  p->numLargeAllocs = 0;
+  p->total = NULL;
+}
+
+void SzArena_Reset(CSzArena *p)
+{
+  p->cur = NULL;
+  p->pos = 0;
+  SzArena_Released(p, p->used - p->largeUsed);
+}
+
+void SzArena_Free(CSzArena *p)
+{
+  CSzArenaChunk *c = p->chunks;
+  while (c)
+  {
+    CSzArenaChunk *next = c->next;
+    free(c);
+    c = next;
+  }
+  p->chunks = NULL;
+  p->cur = NULL;
+  p->pos = 0;
+  SzArena_Released(p, p->used - p->largeUsed);
+  p->reserved = 0;
+}
@@ -6,6 +6,8 @@
 
 #include <stdlib.h>
 
+#include "7zTypes.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,6 +18,49 @@ void SzFree(void *p, void *address);
 void *SzAllocTemp(void *p, size_t size);
 void SzFreeTemp(void *p, void *address);
 
+/* ---------- Arena allocator ----------
+
+  Small blocks are carved from fixed-size chunks and are only released in bulk
+  by SzArena_Reset() / SzArena_Free(). Freeing the most recent small block gives
+  its space back, so alloc/free pairs in stack order (decoder probs) don't grow
+  the arena. Blocks larger than SZ_ARENA_LARGE_SIZE go to malloc/free directly.
+
+  Pass &arena.alloc wherever an (ISzAlloc *) is expected. Arenas that point
+  (total) at the same CSzArenaTotal also count their blocks there, so the peak
+  of memory held by all of them at once can be read from it. */
+
+#define SZ_ARENA_CHUNK_SIZE (1 << 15)
+#define SZ_ARENA_LARGE_SIZE SZ_ARENA_CHUNK_SIZE
+
+typedef struct _CSzArenaChunk CSzArenaChunk;
+
+typedef struct
+{
+  size_t used;         /* bytes held across every arena sharing this total */
+  size_t peak;         /* max value of (used) */
+} CSzArenaTotal;
+
+typedef struct
+{
+  ISzAlloc alloc;      /* must be the first member */
+  CSzArenaChunk *chunks;
+  CSzArenaChunk *cur;
+  size_t pos;          /* bytes used in (cur) */
+  size_t used;         /* bytes handed out and not yet released (arena + large) */
+  size_t largeUsed;
+  size_t peak;         /* max value of (used) */
+  size_t reserved;     /* bytes held in chunks */
+  UInt32 numAllocs;
+  UInt32 numLargeAllocs;
+  CSzArenaTotal *total; /* optional, NULL after SzArena_Init() */
+} CSzArena;
+
+void SzArena_Init(CSzArena *p);
+/* releases all small blocks in O(1); chunks are kept for reuse */
+void SzArena_Reset(CSzArena *p);
+/* releases the chunks; large blocks must have been freed already */
+void SzArena_Free(CSzArena *p);
+
 #ifdef __cplusplus
 }
 #endif
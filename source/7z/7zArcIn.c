@@ -1645,6 +1645,7 @@ SRes SzArEx_Extract(
 {
   UInt32 folderIndex = p->FileToFolder[fileIndex];
   SRes res = SZ_OK;
+  Bool crcChecked = False;
   
   *offset = 0;
   *outSizeProcessed = 0;
@@ -1686,8 +1687,20 @@ SRes SzArEx_Extract(
   
       if (res == SZ_OK)
       {
-        res = SzAr_DecodeFolder(&p->db, folderIndex,
-            inStream, p->dataPos, *tempBuf, unpackSize, allocTemp);
+        /* Check the requested file's CRC while its block is being decoded */
+        CSzCrcRange check;
+        const CSzCrcRange *checkPtr = NULL;
+        if (SzBitWithVals_Check(&p->CRCs, fileIndex))
+        {
+          UInt64 unpackPos = p->UnpackPositions[fileIndex];
+          check.Offset = (size_t)(unpackPos - p->UnpackPositions[p->FolderToFile[folderIndex]]);
+          check.Size = (size_t)(p->UnpackPositions[fileIndex + 1] - unpackPos);
+          check.Crc = p->CRCs.Vals[fileIndex];
+          checkPtr = &check;
+        }
+        res = SzAr_DecodeFolder2(&p->db, folderIndex,
+            inStream, p->dataPos, *tempBuf, unpackSize, checkPtr, allocTemp);
+        crcChecked = (checkPtr != NULL);
       }
     }
   }
@@ -1699,7 +1712,7 @@ SRes SzArEx_Extract(
     *outSizeProcessed = (size_t)(p->UnpackPositions[fileIndex + 1] - unpackPos);
     if (*offset + *outSizeProcessed > *outBufferSize)
       return SZ_ERROR_FAIL;
-    if (SzBitWithVals_Check(&p->CRCs, fileIndex))
+    if (!crcChecked && SzBitWithVals_Check(&p->CRCs, fileIndex))
       if (CrcCalc(*tempBuf + *offset, *outSizeProcessed) != p->CRCs.Vals[fileIndex])
         res = SZ_ERROR_CRC;
   }
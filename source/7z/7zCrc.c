@@ -6,31 +6,36 @@
 #include "7zCrc.h"
 #include "CpuArch.h"
 
-#define kCrcPoly 0xEDB88320
+/* Tables for kCrcPoly 0xEDB88320 are precomputed (7zCrcTable.h).
+   The in-order ARM11 is fastest with slicing-by-4, which also keeps the tables
+   in 4 KiB of its small L1; out-of-order hosts get slicing-by-16. */
 
-#ifdef MY_CPU_LE
-  #define CRC_NUM_TABLES 8
+#if defined(MY_CPU_X86_OR_AMD64) || defined(MY_CPU_ARM64)
+  #define CRC_NUM_TABLES 16
 #else
-  #define CRC_NUM_TABLES 9
-
-  #define CRC_UINT32_SWAP(v) ((v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24))
-
-  UInt32 MY_FAST_CALL CrcUpdateT1_BeT4(UInt32 v, const void *data, size_t size, const UInt32 *table);
-  UInt32 MY_FAST_CALL CrcUpdateT1_BeT8(UInt32 v, const void *data, size_t size, const UInt32 *table);
+  #define CRC_NUM_TABLES 4
 #endif
 
-#ifndef MY_CPU_BE
+#ifdef MY_CPU_LE
   UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const UInt32 *table);
-  UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const UInt32 *table);
+  #if CRC_NUM_TABLES >= 16
+  UInt32 MY_FAST_CALL CrcUpdateT16(UInt32 v, const void *data, size_t size, const UInt32 *table);
+  #endif
 #endif
 
 typedef UInt32 (MY_FAST_CALL *CRC_FUNC)(UInt32 v, const void *data, size_t size, const UInt32 *table);
 
-CRC_FUNC g_CrcUpdateT4;
-CRC_FUNC g_CrcUpdateT8;
-CRC_FUNC g_CrcUpdate;
+/* Hardware kernels (7zCrcOpt.c), NULL if the running CPU can't use them */
+CRC_FUNC CrcGetHwKernel(void);
+
+const UInt32 g_CrcTable[256 * CRC_NUM_TABLES] =
+{
+#include "7zCrcTable.h"
+};
+
+static UInt32 MY_FAST_CALL CrcUpdateSelect(UInt32 v, const void *data, size_t size, const UInt32 *table);
 
-UInt32 g_CrcTable[256 * CRC_NUM_TABLES];
+static CRC_FUNC g_CrcUpdate = CrcUpdateSelect;
 
 UInt32 MY_FAST_CALL CrcUpdate(UInt32 v, const void *data, size_t size)
 {
@@ -53,76 +58,32 @@ UInt32 MY_FAST_CALL CrcUpdateT1(UInt32 v, const void *data, size_t size, const U
   return v;
 }
 
-void MY_FAST_CALL CrcGenerateTable()
+static CRC_FUNC CrcSelectKernel(void)
 {
-  UInt32 i;
-  for (i = 0; i < 256; i++)
-  {
-    UInt32 r = i;
-    unsigned j;
-    for (j = 0; j < 8; j++)
-      r = (r >> 1) ^ (kCrcPoly & ~((r & 1) - 1));
-    g_CrcTable[i] = r;
-  }
-  for (; i < 256 * CRC_NUM_TABLES; i++)
+  #ifdef MY_CPU_LE
   {
-    UInt32 r = g_CrcTable[i - 256];
-    g_CrcTable[i] = g_CrcTable[r & 0xFF] ^ (r >> 8);
+    CRC_FUNC hw = CrcGetHwKernel();
+    if (hw)
+      return hw;
   }
-
-  #if CRC_NUM_TABLES < 4
-  
-  g_CrcUpdate = CrcUpdateT1;
-  
-  #else
- 
-  #ifdef MY_CPU_LE
-
-    g_CrcUpdateT4 = CrcUpdateT4;
-    g_CrcUpdate = CrcUpdateT4;
-
-    #if CRC_NUM_TABLES >= 8
-      g_CrcUpdateT8 = CrcUpdateT8;
-  
-      #ifdef MY_CPU_X86_OR_AMD64
-      if (!CPU_Is_InOrder())
-        g_CrcUpdate = CrcUpdateT8;
-      #endif
+    #if CRC_NUM_TABLES >= 16
+    return CrcUpdateT16;
+    #else
+    return CrcUpdateT4;
     #endif
-
   #else
-  {
-    #ifndef MY_CPU_BE
-    UInt32 k = 0x01020304;
-    const Byte *p = (const Byte *)&k;
-    if (p[0] == 4 && p[1] == 3)
-    {
-      g_CrcUpdateT4 = CrcUpdateT4;
-      g_CrcUpdate = CrcUpdateT4;
-      #if CRC_NUM_TABLES >= 8
-      g_CrcUpdateT8 = CrcUpdateT8;
-      // g_CrcUpdate = CrcUpdateT8;
-      #endif
-    }
-    else if (p[0] != 1 || p[1] != 2)
-      g_CrcUpdate = CrcUpdateT1;
-    else
-    #endif
-    {
-      for (i = 256 * CRC_NUM_TABLES - 1; i >= 256; i--)
-      {
-        UInt32 x = g_CrcTable[i - 256];
-        g_CrcTable[i] = CRC_UINT32_SWAP(x);
-      }
-      g_CrcUpdateT4 = CrcUpdateT1_BeT4;
-      g_CrcUpdate = CrcUpdateT1_BeT4;
-      #if CRC_NUM_TABLES >= 8
-      g_CrcUpdateT8 = CrcUpdateT1_BeT8;
-      // g_CrcUpdate = CrcUpdateT1_BeT8;
-      #endif
-    }
-  }
+  return CrcUpdateT1;
   #endif
+}
 
-  #endif
+/* First call picks the kernel for the running CPU, later calls go straight to it */
+static UInt32 MY_FAST_CALL CrcUpdateSelect(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  g_CrcUpdate = CrcSelectKernel();
+  return g_CrcUpdate(v, data, size, table);
+}
+
+void MY_FAST_CALL CrcGenerateTable()
+{
+  g_CrcUpdate = CrcSelectKernel();
 }
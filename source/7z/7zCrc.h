@@ -8,9 +8,10 @@
 
 EXTERN_C_BEGIN
 
-extern UInt32 g_CrcTable[];
+extern const UInt32 g_CrcTable[];
 
-/* Call CrcGenerateTable one time before other CRC functions */
+/* CRC tables are precomputed and the fastest kernel for the running CPU is
+   picked on first use. CrcGenerateTable only makes that choice up front. */
 void MY_FAST_CALL CrcGenerateTable(void);
 
 #define CRC_INIT_VAL 0xFFFFFFFF
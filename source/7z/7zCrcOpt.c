@@ -5,7 +5,9 @@
 
 #include "CpuArch.h"
 
-#ifndef MY_CPU_BE
+typedef UInt32 (MY_FAST_CALL *CRC_FUNC)(UInt32 v, const void *data, size_t size, const UInt32 *table);
+
+#ifdef MY_CPU_LE
 
 #define CRC_UPDATE_BYTE_2(crc, b) (table[((crc) ^ (b)) & 0xFF] ^ ((crc) >> 8))
 
@@ -28,26 +30,36 @@ UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const U
   return v;
 }
 
-UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const UInt32 *table)
+#if defined(MY_CPU_X86_OR_AMD64) || defined(MY_CPU_ARM64)
+
+UInt32 MY_FAST_CALL CrcUpdateT16(UInt32 v, const void *data, size_t size, const UInt32 *table)
 {
   const Byte *p = (const Byte *)data;
-  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 7) != 0; size--, p++)
+  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 3) != 0; size--, p++)
     v = CRC_UPDATE_BYTE_2(v, *p);
-  for (; size >= 8; size -= 8, p += 8)
+  for (; size >= 16; size -= 16, p += 16)
   {
-    UInt32 d;
+    UInt32 d1 = *((const UInt32 *)p + 1);
+    UInt32 d2 = *((const UInt32 *)p + 2);
+    UInt32 d3 = *((const UInt32 *)p + 3);
     v ^= *(const UInt32 *)p;
     v =
-          table[0x700 + ((v      ) & 0xFF)]
-        ^ table[0x600 + ((v >>  8) & 0xFF)]
-        ^ table[0x500 + ((v >> 16) & 0xFF)]
-        ^ table[0x400 + ((v >> 24))];
-    d = *((const UInt32 *)p + 1);
-    v ^=
-          table[0x300 + ((d      ) & 0xFF)]
-        ^ table[0x200 + ((d >>  8) & 0xFF)]
-        ^ table[0x100 + ((d >> 16) & 0xFF)]
-        ^ table[0x000 + ((d >> 24))];
+          table[0xF00 + ((v       ) & 0xFF)]
+        ^ table[0xE00 + ((v  >>  8) & 0xFF)]
+        ^ table[0xD00 + ((v  >> 16) & 0xFF)]
+        ^ table[0xC00 + ((v  >> 24))]
+        ^ table[0xB00 + ((d1      ) & 0xFF)]
+        ^ table[0xA00 + ((d1 >>  8) & 0xFF)]
+        ^ table[0x900 + ((d1 >> 16) & 0xFF)]
+        ^ table[0x800 + ((d1 >> 24))]
+        ^ table[0x700 + ((d2      ) & 0xFF)]
+        ^ table[0x600 + ((d2 >>  8) & 0xFF)]
+        ^ table[0x500 + ((d2 >> 16) & 0xFF)]
+        ^ table[0x400 + ((d2 >> 24))]
+        ^ table[0x300 + ((d3      ) & 0xFF)]
+        ^ table[0x200 + ((d3 >>  8) & 0xFF)]
+        ^ table[0x100 + ((d3 >> 16) & 0xFF)]
+        ^ table[0x000 + ((d3 >> 24))];
   }
   for (; size > 0; size--, p++)
     v = CRC_UPDATE_BYTE_2(v, *p);
@@ -56,60 +68,160 @@ UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const U
 
 #endif
 
+#endif
+
 
-#ifndef MY_CPU_LE
+/* ---------- Hardware kernels (Linux host builds only) ---------- */
 
-#define CRC_UINT32_SWAP(v) ((v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24))
+#if defined(MY_CPU_AMD64) && defined(MY_CPU_LE) && defined(__GNUC__) && defined(__linux__)
 
-#define CRC_UPDATE_BYTE_2_BE(crc, b) (table[(((crc) >> 24) ^ (b))] ^ ((crc) << 8))
+/* PCLMULQDQ folding, 4 x 128 bits at a time, with a Barrett reduction at the end
+   (Gopal et al., "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ") */
 
-UInt32 MY_FAST_CALL CrcUpdateT1_BeT4(UInt32 v, const void *data, size_t size, const UInt32 *table)
+#include <immintrin.h>
+
+static const UInt64 k_CrcFold4[2]  __attribute__((aligned(16))) = { 0x0154442BD4, 0x01C6E41596 };
+static const UInt64 k_CrcFold1[2]  __attribute__((aligned(16))) = { 0x01751997D0, 0x00CCAA009E };
+static const UInt64 k_CrcFold64[2] __attribute__((aligned(16))) = { 0x0163CD6124, 0x0000000000 };
+static const UInt64 k_CrcBarrett[2] __attribute__((aligned(16))) = { 0x01DB710641, 0x01F7011641 };
+
+/* size must be a multiple of 16, at least 64 */
+__attribute__((target("pclmul,sse4.1")))
+static UInt32 CrcFoldPclmul(UInt32 v, const Byte *p, size_t size)
+{
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i *)(const void *)(p + 0x00));
+  x2 = _mm_loadu_si128((const __m128i *)(const void *)(p + 0x10));
+  x3 = _mm_loadu_si128((const __m128i *)(const void *)(p + 0x20));
+  x4 = _mm_loadu_si128((const __m128i *)(const void *)(p + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)v));
+  x0 = _mm_load_si128((const __m128i *)(const void *)k_CrcFold4);
+  p += 64;
+  size -= 64;
+
+  for (; size >= 64; size -= 64, p += 64)
+  {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(const void *)(p + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(const void *)(p + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(const void *)(p + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(const void *)(p + 0x30)));
+  }
+
+  /* fold 4 x 128 bits into 128 bits */
+  x0 = _mm_load_si128((const __m128i *)(const void *)k_CrcFold1);
+  #define CRC_FOLD_1(next) \
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00); \
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11); \
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, next), x5);
+  CRC_FOLD_1(x2)
+  CRC_FOLD_1(x3)
+  CRC_FOLD_1(x4)
+
+  for (; size >= 16; size -= 16, p += 16)
+  {
+    x2 = _mm_loadu_si128((const __m128i *)(const void *)p);
+    CRC_FOLD_1(x2)
+  }
+
+  /* 128 -> 64 bits */
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = _mm_loadl_epi64((const __m128i *)(const void *)k_CrcFold64);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits */
+  x0 = _mm_load_si128((const __m128i *)(const void *)k_CrcBarrett);
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (UInt32)_mm_extract_epi32(x1, 1);
+}
+
+static UInt32 MY_FAST_CALL CrcUpdatePclmul(UInt32 v, const void *data, size_t size, const UInt32 *table)
 {
   const Byte *p = (const Byte *)data;
-  table += 0x100;
-  v = CRC_UINT32_SWAP(v);
-  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 3) != 0; size--, p++)
-    v = CRC_UPDATE_BYTE_2_BE(v, *p);
-  for (; size >= 4; size -= 4, p += 4)
+  if (size >= 64)
   {
-    v ^= *(const UInt32 *)p;
-    v =
-          table[0x000 + ((v      ) & 0xFF)]
-        ^ table[0x100 + ((v >>  8) & 0xFF)]
-        ^ table[0x200 + ((v >> 16) & 0xFF)]
-        ^ table[0x300 + ((v >> 24))];
+    size_t folded = size & ~(size_t)15;
+    v = CrcFoldPclmul(v, p, folded);
+    p += folded;
+    size -= folded;
   }
-  for (; size > 0; size--, p++)
-    v = CRC_UPDATE_BYTE_2_BE(v, *p);
-  return CRC_UINT32_SWAP(v);
+  return CrcUpdateT16(v, p, size, table);
 }
 
-UInt32 MY_FAST_CALL CrcUpdateT1_BeT8(UInt32 v, const void *data, size_t size, const UInt32 *table)
+CRC_FUNC CrcGetHwKernel(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    return CrcUpdatePclmul;
+  return NULL;
+}
+
+#elif defined(MY_CPU_ARM64) && defined(MY_CPU_LE) && defined(__GNUC__) && defined(__linux__)
+
+/* ARMv8 CRC32 instructions (optional in ARMv8.0, probed through HWCAP) */
+
+#include <sys/auxv.h>
+
+#pragma GCC push_options
+#pragma GCC target("+crc")
+#include <arm_acle.h>
+
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+
+static UInt32 MY_FAST_CALL CrcUpdateArm64(UInt32 v, const void *data, size_t size, const UInt32 *table)
 {
   const Byte *p = (const Byte *)data;
-  table += 0x100;
-  v = CRC_UINT32_SWAP(v);
+  UNUSED_VAR(table);
   for (; size > 0 && ((unsigned)(ptrdiff_t)p & 7) != 0; size--, p++)
-    v = CRC_UPDATE_BYTE_2_BE(v, *p);
-  for (; size >= 8; size -= 8, p += 8)
+    v = __crc32b(v, *p);
+  for (; size >= 32; size -= 32, p += 32)
   {
-    UInt32 d;
-    v ^= *(const UInt32 *)p;
-    v =
-          table[0x400 + ((v      ) & 0xFF)]
-        ^ table[0x500 + ((v >>  8) & 0xFF)]
-        ^ table[0x600 + ((v >> 16) & 0xFF)]
-        ^ table[0x700 + ((v >> 24))];
-    d = *((const UInt32 *)p + 1);
-    v ^=
-          table[0x000 + ((d      ) & 0xFF)]
-        ^ table[0x100 + ((d >>  8) & 0xFF)]
-        ^ table[0x200 + ((d >> 16) & 0xFF)]
-        ^ table[0x300 + ((d >> 24))];
+    v = __crc32d(v, *((const UInt64 *)(const void *)p + 0));
+    v = __crc32d(v, *((const UInt64 *)(const void *)p + 1));
+    v = __crc32d(v, *((const UInt64 *)(const void *)p + 2));
+    v = __crc32d(v, *((const UInt64 *)(const void *)p + 3));
   }
+  for (; size >= 8; size -= 8, p += 8)
+    v = __crc32d(v, *(const UInt64 *)(const void *)p);
   for (; size > 0; size--, p++)
-    v = CRC_UPDATE_BYTE_2_BE(v, *p);
-  return CRC_UINT32_SWAP(v);
+    v = __crc32b(v, *p);
+  return v;
+}
+
+#pragma GCC pop_options
+
+CRC_FUNC CrcGetHwKernel(void)
+{
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+    return CrcUpdateArm64;
+  return NULL;
+}
+
+#else
+
+CRC_FUNC CrcGetHwKernel(void)
+{
+  return NULL;
 }
 
 #endif
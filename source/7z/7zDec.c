@@ -257,7 +257,61 @@ static SRes CheckSupportedFolder(const CSzFolder *f)
   return SZ_ERROR_UNSUPPORTED;
 }
 
-#define CASE_BRA_CONV(isa) case k_ ## isa: isa ## _Convert(outBuffer, outSize, 0, 0); break;
+#ifndef _7Z_NO_METHODS_FILTERS
+
+/* Branch converters are run over the output in slices that fit in L1,
+   and each converted slice is fed to the CRC check (if any) right away,
+   so verifying a filtered folder doesn't cost another pass over cold memory */
+
+#define k_BraSliceSize (1 << 14)
+
+#define CASE_BRA_CONV(isa) case k_ ## isa: processed = isa ## _Convert(outBuffer + pos, cur, (UInt32)pos, 0); break;
+
+static SRes SzDecodeBra(UInt32 methodID, Byte *outBuffer, SizeT outSize,
+    const CSzCrcRange *check, UInt32 *crc)
+{
+  UInt32 x86State;
+  SizeT pos = 0;
+  x86_Convert_Init(x86State);
+
+  while (pos < outSize)
+  {
+    SizeT cur = outSize - pos;
+    SizeT processed;
+    if (cur > k_BraSliceSize)
+      cur = k_BraSliceSize;
+
+    switch (methodID)
+    {
+      case k_BCJ: processed = x86_Convert(outBuffer + pos, cur, (UInt32)pos, &x86State, 0); break;
+      CASE_BRA_CONV(ARM)
+      CASE_BRA_CONV(ARMT)
+      default:
+        return SZ_ERROR_UNSUPPORTED;
+    }
+
+    /* the tail left over by the last slice stays unconverted, as in a whole-buffer call */
+    if (pos + cur == outSize)
+      processed = cur;
+
+    if (check)
+    {
+      size_t start = pos, end = pos + processed;
+      if (start < check->Offset)
+        start = check->Offset;
+      if (end > check->Offset + check->Size)
+        end = check->Offset + check->Size;
+      if (start < end)
+        *crc = CrcUpdate(*crc, outBuffer + start, end - start);
+    }
+
+    pos += processed;
+  }
+
+  return SZ_OK;
+}
+
+#endif
 
 static SRes SzFolder_Decode2(const CSzFolder *folder,
     const Byte *propsData,
@@ -265,12 +319,14 @@ static SRes SzFolder_Decode2(const CSzFolder *folder,
     const UInt64 *packPositions,
     ILookInStream *inStream, UInt64 startPos,
     Byte *outBuffer, SizeT outSize, ISzAlloc *allocMain,
-    Byte *tempBuf[])
+    Byte *tempBuf[], const CSzCrcRange *check)
 {
   UInt32 ci;
   SizeT tempSizes[3] = { 0, 0, 0};
   SizeT tempSize3 = 0;
   Byte *tempBuf3 = 0;
+  UInt32 crc = CRC_INIT_VAL;
+  Bool crcDone = False;
 
   RINOK(CheckSupportedFolder(folder));
 
@@ -410,20 +466,8 @@ static SRes SzFolder_Decode2(const CSzFolder *folder,
       {
         if (coder->PropsSize != 0)
           return SZ_ERROR_UNSUPPORTED;
-        switch (coder->MethodID)
-        {
-          case k_BCJ:
-          {
-            UInt32 state;
-            x86_Convert_Init(state);
-            x86_Convert(outBuffer, outSize, 0, &state, 0);
-            break;
-          }
-          CASE_BRA_CONV(ARM)
-          CASE_BRA_CONV(ARMT)
-          default:
-            return SZ_ERROR_UNSUPPORTED;
-        }
+        RINOK(SzDecodeBra((UInt32)coder->MethodID, outBuffer, outSize, check, &crc));
+        crcDone = True;
       }
     }
     #endif
@@ -431,6 +475,16 @@ static SRes SzFolder_Decode2(const CSzFolder *folder,
       return SZ_ERROR_UNSUPPORTED;
   }
 
+  if (check)
+  {
+    if (check->Offset > outSize || check->Size > outSize - check->Offset)
+      return SZ_ERROR_FAIL;
+    if (!crcDone)
+      crc = CrcUpdate(crc, outBuffer + check->Offset, check->Size);
+    if (CRC_GET_DIGEST(crc) != check->Crc)
+      return SZ_ERROR_CRC;
+  }
+
   return SZ_OK;
 }
 
@@ -439,6 +493,16 @@ SRes SzAr_DecodeFolder(const CSzAr *p, UInt32 folderIndex,
     ILookInStream *inStream, UInt64 startPos,
     Byte *outBuffer, size_t outSize,
     ISzAlloc *allocMain)
+{
+  return SzAr_DecodeFolder2(p, folderIndex, inStream, startPos, outBuffer, outSize, NULL, allocMain);
+}
+
+
+SRes SzAr_DecodeFolder2(const CSzAr *p, UInt32 folderIndex,
+    ILookInStream *inStream, UInt64 startPos,
+    Byte *outBuffer, size_t outSize,
+    const CSzCrcRange *check,
+    ISzAlloc *allocMain)
 {
   SRes res;
   CSzFolder folder;
@@ -460,20 +524,31 @@ SRes SzAr_DecodeFolder(const CSzAr *p, UInt32 folderIndex,
   {
     unsigned i;
     Byte *tempBuf[3] = { 0, 0, 0};
+    Bool hasFolderCrc = SzBitWithVals_Check(&p->FolderCRCs, folderIndex);
+    CSzCrcRange folderCheck;
+
+    /* With no range to check, verify the whole folder on the fly instead */
+    if (!check && hasFolderCrc)
+    {
+      folderCheck.Offset = 0;
+      folderCheck.Size = outSize;
+      folderCheck.Crc = p->FolderCRCs.Vals[folderIndex];
+      check = &folderCheck;
+      hasFolderCrc = False;
+    }
 
     res = SzFolder_Decode2(&folder, data,
         &p->CoderUnpackSizes[p->FoToCoderUnpackSizes[folderIndex]],
         p->PackPositions + p->FoStartPackStreamIndex[folderIndex],
         inStream, startPos,
-        outBuffer, (SizeT)outSize, allocMain, tempBuf);
+        outBuffer, (SizeT)outSize, allocMain, tempBuf, check);
     
     for (i = 0; i < 3; i++)
       IAlloc_Free(allocMain, tempBuf[i]);
 
-    if (res == SZ_OK)
-      if (SzBitWithVals_Check(&p->FolderCRCs, folderIndex))
-        if (CrcCalc(outBuffer, outSize) != p->FolderCRCs.Vals[folderIndex])
-          res = SZ_ERROR_CRC;
+    if (res == SZ_OK && hasFolderCrc)
+      if (CrcCalc(outBuffer, outSize) != p->FolderCRCs.Vals[folderIndex])
+        res = SZ_ERROR_CRC;
 
     return res;
   }
@@ -4,6 +4,7 @@
 #include "Precomp.h"
 
 #include "Bra.h"
+#include "CpuArch.h"
 
 SizeT ARM_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
 {
@@ -12,6 +13,31 @@ SizeT ARM_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
     return 0;
   size -= 4;
   ip += 8;
+
+  #ifdef MY_CPU_LE
+  if (((size_t)data & 3) == 0)
+  {
+    /* BL opcodes have 0xEB in the high byte of an aligned little endian word,
+       so test and patch whole words instead of assembling them byte by byte */
+    UInt32 *p = (UInt32 *)(void *)data;
+    for (i = 0; i <= size; i += 4, p++)
+    {
+      UInt32 v = *p;
+      if ((v >> 24) == 0xEB)
+      {
+        UInt32 dest;
+        UInt32 src = (v & 0xFFFFFF) << 2;
+        if (encoding)
+          dest = ip + (UInt32)i + src;
+        else
+          dest = src - (ip + (UInt32)i);
+        *p = 0xEB000000 | ((dest >> 2) & 0xFFFFFF);
+      }
+    }
+    return i;
+  }
+  #endif
+
   for (i = 0; i <= size; i += 4)
   {
     if (data[i + 3] == 0xEB)
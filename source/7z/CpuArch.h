@@ -21,6 +21,24 @@ MY_CPU_LE_UNALIGN means that CPU is LITTLE ENDIAN and CPU supports unaligned mem
   #define MY_CPU_64BIT
 #endif
 
+#if defined(_M_X64) \
+    || defined(_M_AMD64) \
+    || defined(__x86_64__)
+  #define MY_CPU_AMD64
+#endif
+
+#if defined(MY_CPU_AMD64) \
+    || defined(_M_IX86) \
+    || defined(__i386__)
+  #define MY_CPU_X86_OR_AMD64
+#endif
+
+#if defined(__AARCH64EL__) \
+    || defined(__AARCH64EB__) \
+    || defined(_M_ARM64)
+  #define MY_CPU_ARM64
+#endif
+
 #if defined(_M_ARM) \
     || defined(__ARMEL__) \
     || defined(__THUMBEL__) \
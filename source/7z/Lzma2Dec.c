@@ -140,17 +140,16 @@ static ELzma2State Lzma2Dec_UpdateState(CLzma2Dec *p, Byte b)
 
     case LZMA2_STATE_PROP:
     {
-      unsigned lc, lp;
+      unsigned lc, lp, pb;
       if (b >= (9 * 5 * 5))
         return LZMA2_STATE_ERROR;
       lc = b % 9;
       b /= 9;
-      p->decoder.prop.pb = b / 5;
+      pb = b / 5;
       lp = b % 5;
       if (lc + lp > LZMA2_LCLP_MAX)
         return LZMA2_STATE_ERROR;
-      p->decoder.prop.lc = lc;
-      p->decoder.prop.lp = lp;
+      LzmaDec_SetProps(&p->decoder, lc, lp, pb);
       p->needInitProp = False;
       return LZMA2_STATE_DATA;
     }
@@ -137,15 +137,17 @@ Out:
     = kMatchSpecLenStart + 2 : State Init Marker (unused now)
 */
 
-static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte *bufLimit)
+/* The main loop is written once and instantiated below, either with lc/lp/pb
+   taken from p->prop (generic) or with compile-time constants, which lets the
+   compiler fold the literal context shifts and position masks. */
+
+static MY_FORCE_INLINE int LzmaDec_DecodeRealImpl(CLzmaDec *p, SizeT limit, const Byte *bufLimit,
+    unsigned lc, unsigned lpMask, unsigned pbMask)
 {
   CLzmaProb *probs = p->probs;
 
   unsigned state = p->state;
   UInt32 rep0 = p->reps[0], rep1 = p->reps[1], rep2 = p->reps[2], rep3 = p->reps[3];
-  unsigned pbMask = ((unsigned)1 << (p->prop.pb)) - 1;
-  unsigned lpMask = ((unsigned)1 << (p->prop.lp)) - 1;
-  unsigned lc = p->prop.lc;
 
   Byte *dic = p->dic;
   SizeT dicBufSize = p->dicBufSize;
@@ -512,6 +514,49 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
   return SZ_OK;
 }
 
+static int MY_FAST_CALL LzmaDec_DecodeReal_Generic(CLzmaDec *p, SizeT limit, const Byte *bufLimit)
+{
+  return LzmaDec_DecodeRealImpl(p, limit, bufLimit, p->prop.lc,
+      ((unsigned)1 << (p->prop.lp)) - 1, ((unsigned)1 << (p->prop.pb)) - 1);
+}
+
+#define LZMA_DECODE_REAL_SPEC(lc, lp, pb) \
+  static int MY_FAST_CALL LzmaDec_DecodeReal_##lc##lp##pb(CLzmaDec *p, SizeT limit, const Byte *bufLimit) \
+  { return LzmaDec_DecodeRealImpl(p, limit, bufLimit, lc, ((unsigned)1 << lp) - 1, ((unsigned)1 << pb) - 1); }
+
+/* lc=3 lp=0 pb=2: 7-Zip / LZMA2 defaults, used by every Luma3DS release so far */
+LZMA_DECODE_REAL_SPEC(3, 0, 2)
+/* lc=0 lp=2 pb=2: recommended settings for 32-bit aligned (ARM) code */
+LZMA_DECODE_REAL_SPEC(0, 2, 2)
+
+#ifdef _LZMA_DEC_BENCH
+int g_LzmaDec_ForceGeneric = 0;
+#endif
+
+static void LzmaDec_SelectDecodeReal(CLzmaDec *p)
+{
+  const CLzmaProps *prop = &p->prop;
+  #ifdef _LZMA_DEC_BENCH
+  if (g_LzmaDec_ForceGeneric)
+    p->decodeReal = LzmaDec_DecodeReal_Generic;
+  else
+  #endif
+  if (prop->lc == 3 && prop->lp == 0 && prop->pb == 2)
+    p->decodeReal = LzmaDec_DecodeReal_302;
+  else if (prop->lc == 0 && prop->lp == 2 && prop->pb == 2)
+    p->decodeReal = LzmaDec_DecodeReal_022;
+  else
+    p->decodeReal = LzmaDec_DecodeReal_Generic;
+}
+
+void LzmaDec_SetProps(CLzmaDec *p, unsigned lc, unsigned lp, unsigned pb)
+{
+  p->prop.lc = lc;
+  p->prop.lp = lp;
+  p->prop.pb = pb;
+  LzmaDec_SelectDecodeReal(p);
+}
+
 static void MY_FAST_CALL LzmaDec_WriteRem(CLzmaDec *p, SizeT limit)
 {
   if (p->remainLen != 0 && p->remainLen < kMatchSpecLenStart)
@@ -552,7 +597,7 @@ static int MY_FAST_CALL LzmaDec_DecodeReal2(CLzmaDec *p, SizeT limit, const Byte
         limit2 = p->dicPos + rem;
     }
     
-    RINOK(LzmaDec_DecodeReal(p, limit2, bufLimit));
+    RINOK(p->decodeReal(p, limit2, bufLimit));
     
     if (p->checkDicSize == 0 && p->processedPos >= p->prop.dicSize)
       p->checkDicSize = p->prop.dicSize;
@@ -1039,6 +1084,7 @@ SRes LzmaDec_AllocateProbs(CLzmaDec *p, const Byte *props, unsigned propsSize, I
   RINOK(LzmaProps_Decode(&propNew, props, propsSize));
   RINOK(LzmaDec_AllocateProbs2(p, &propNew, alloc));
   p->prop = propNew;
+  LzmaDec_SelectDecodeReal(p);
   return SZ_OK;
 }
 
@@ -1071,6 +1117,7 @@ SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAll
   }
   p->dicBufSize = dicBufSize;
   p->prop = propNew;
+  LzmaDec_SelectDecodeReal(p);
   return SZ_OK;
 }
 
@@ -45,7 +45,7 @@ SRes LzmaProps_Decode(CLzmaProps *p, const Byte *data, unsigned size);
 
 #define LZMA_REQUIRED_INPUT_MAX 20
 
-typedef struct
+typedef struct _CLzmaDec
 {
   CLzmaProps prop;
   CLzmaProb *probs;
@@ -64,9 +64,12 @@ typedef struct
   UInt32 numProbs;
   unsigned tempBufSize;
   Byte tempBuf[LZMA_REQUIRED_INPUT_MAX];
+  /* main decode loop, specialized for (lc, lp, pb) when possible;
+     chosen by LzmaDec_Allocate / LzmaDec_AllocateProbs */
+  int (MY_FAST_CALL *decodeReal)(struct _CLzmaDec *p, SizeT limit, const Byte *bufLimit);
 } CLzmaDec;
 
-#define LzmaDec_Construct(p) { (p)->dic = 0; (p)->probs = 0; }
+#define LzmaDec_Construct(p) { (p)->dic = 0; (p)->probs = 0; (p)->decodeReal = 0; }
 
 void LzmaDec_Init(CLzmaDec *p);
 
@@ -135,6 +138,15 @@ void LzmaDec_FreeProbs(CLzmaDec *p, ISzAlloc *alloc);
 SRes LzmaDec_Allocate(CLzmaDec *state, const Byte *prop, unsigned propsSize, ISzAlloc *alloc);
 void LzmaDec_Free(CLzmaDec *state, ISzAlloc *alloc);
 
+/* Changes lc/lp/pb of an allocated decoder (LZMA2 chunks can) and picks the matching
+   main decode loop. The probabilities must already be allocated for lc + lp. */
+void LzmaDec_SetProps(CLzmaDec *p, unsigned lc, unsigned lp, unsigned pb);
+
+#ifdef _LZMA_DEC_BENCH
+/* Host benchmarks only (tools/): when set, decoders always pick the generic main loop */
+extern int g_LzmaDec_ForceGeneric;
+#endif
+
 /* ---------- Dictionary Interface ---------- */
 
 /* You can use it, if you want to eliminate the overhead for data copying from
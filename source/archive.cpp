@@ -1,12 +1,28 @@
 #include "archive.h"
+#include "unicode.h"
 #include "utils.h"
 
+static const u8 ZipSignature[] = { 'P', 'K', 0x03, 0x04 };
+
+std::unique_ptr<Archive> Archive::open(const u8* arcData, const u32 arcSize) {
+	if (arcSize >= sizeof(ZipSignature) && std::memcmp(arcData, ZipSignature, sizeof(ZipSignature)) == 0) {
+		return std::unique_ptr<Archive>(new ZipArchive(arcData, arcSize));
+	}
+	if (arcSize >= k7zSignatureSize && std::memcmp(arcData, k7zSignature, k7zSignatureSize) == 0) {
+		return std::unique_ptr<Archive>(new SzArchive(arcData, arcSize));
+	}
+	throw std::runtime_error("Unknown archive format");
+}
+
 ZipArchive::ZipArchive(const u8* arcData, const u32 arcSize) {
+	// minizip only reads from the buffer, no need for a copy
 	unzmem.size = arcSize;
-	unzmem.base = (char*)malloc(unzmem.size);
-	std::memcpy(unzmem.base, arcData, unzmem.size);
+	unzmem.base = (char*)arcData;
 	fill_memory_filefunc(&filefunc32, &unzmem);
 	zipfile = unzOpen2("__notused__", &filefunc32);
+	if (zipfile == nullptr) {
+		throw std::runtime_error("Could not open archive (unzOpen2)");
+	}
 }
 
 ZipArchive::~ZipArchive() {
@@ -14,7 +30,55 @@ ZipArchive::~ZipArchive() {
 	unzClose(zipfile);
 }
 
-void ZipArchive::extractFile(std::string name, u8** fileData, size_t* fileSize) {
+void ZipArchive::scan(std::vector<ArchiveEntry>* entryList, std::vector<ArchiveBlock>* blockList) {
+	u32 blockCount = 0;
+	for (int res = unzGoToFirstFile(zipfile); res == UNZ_OK; res = unzGoToNextFile(zipfile)) {
+		unz_file_info info = {};
+		char name[256] = { 0 };
+		if (unzGetCurrentFileInfo(zipfile, &info, name, sizeof(name), nullptr, 0, nullptr, 0) != UNZ_OK) {
+			throw std::runtime_error("Could not read zip directory");
+		}
+		std::string nameStr(name);
+		bool isDir = !nameStr.empty() && nameStr.back() == '/';
+		u32 block = isDir ? ArchiveEntry::NoBlock : blockCount++;
+
+		if (entryList != nullptr) {
+			entryList->push_back(ArchiveEntry{ nameStr, info.uncompressed_size, isDir, block });
+		}
+		if (blockList != nullptr && !isDir) {
+			std::string method;
+			switch (info.compression_method) {
+			case 0:
+				method = "Store";
+				break;
+			case Z_DEFLATED:
+				method = "Deflate";
+				break;
+			default:
+				method = "Method " + tostr(info.compression_method);
+			}
+			blockList->push_back(ArchiveBlock{ method, info.compressed_size, info.uncompressed_size, 1 });
+		}
+	}
+}
+
+std::vector<ArchiveEntry> ZipArchive::entries() {
+	std::vector<ArchiveEntry> list;
+	scan(&list, nullptr);
+	return list;
+}
+
+std::vector<ArchiveBlock> ZipArchive::blocks() {
+	std::vector<ArchiveBlock> list;
+	scan(nullptr, &list);
+	return list;
+}
+
+bool ZipArchive::contains(const std::string& name) {
+	return !name.empty() && name.back() != '/' && unzLocateFile(zipfile, name.c_str(), nullptr) == UNZ_OK;
+}
+
+ArchiveBuffer ZipArchive::extractFile(const std::string& name) {
 	int res = unzLocateFile(zipfile, name.c_str(), nullptr);
 	if (res == UNZ_END_OF_LIST_OF_FILE) {
 		throw std::runtime_error("Could not find " + name + " in zip file");
@@ -25,37 +89,48 @@ void ZipArchive::extractFile(std::string name, u8** fileData, size_t* fileSize)
 	if (res != UNZ_OK) {
 		throw std::runtime_error("Could not read metadata for " + name);
 	}
-	*fileSize = payloadInfo.uncompressed_size;
 
 	res = unzOpenCurrentFile(zipfile);
 	if (res != UNZ_OK) {
 		throw std::runtime_error("Could not open " + name + " for reading");
 	}
 
-	*fileData = (u8*)malloc(*fileSize);
-	res = unzReadCurrentFile(zipfile, *fileData, *fileSize);
+	ArchiveBuffer file;
+	file.size = payloadInfo.uncompressed_size;
+	file.base = std::shared_ptr<u8>((u8*)malloc(file.size), std::free);
+	file.data = file.base.get();
+	res = unzReadCurrentFile(zipfile, file.data, file.size);
 	if (res < 0) {
 		throw std::runtime_error("Could not read " + name + " (" + tostr(res) + ")");
 	}
 
-	if (res != (int)*fileSize) {
-		throw std::runtime_error("Extracted size does not match expected! (got " + tostr(res) + " expected " + tostr(*fileSize) + ")");
+	if (res != (int)file.size) {
+		throw std::runtime_error("Extracted size does not match expected! (got " + tostr(res) + " expected " + tostr(file.size) + ")");
 	}
+
+	// zlib's inflate state is not tracked, only the output buffer
+	lastPeak = file.size;
+	return file;
 }
 
 SzArchive::SzArchive(const u8* arcData, const u32 arcSize) {
 	MemInStream_Init(&memStream, arcData, arcSize);
 
-	allocImp.Alloc = SzAlloc;
-	allocImp.Free = SzFree;
-	allocTempImp.Alloc = SzAllocTemp;
-	allocTempImp.Free = SzFreeTemp;
+	SzArena_Init(&arena);
+	SzArena_Init(&tempArena);
+	arena.total = &arenaTotal;
+	tempArena.total = &arenaTotal;
+	allocOutImp.Alloc = SzAlloc;
+	allocOutImp.Free = SzFree;
 
-	CrcGenerateTable();
 	SzArEx_Init(&db);
 
-	SRes res = SzArEx_Open(&db, &memStream.s, &allocImp, &allocTempImp);
+	SRes res = SzArEx_Open(&db, &memStream.s, &arena.alloc, &tempArena.alloc);
+	SzArena_Reset(&tempArena);
 	if (res != SZ_OK) {
+		SzArEx_Free(&db, &arena.alloc);
+		SzArena_Free(&arena);
+		SzArena_Free(&tempArena);
 		throw std::runtime_error("Could not open archive (SzArEx_Open)\n");
 	}
 
@@ -63,60 +138,164 @@ SzArchive::SzArchive(const u8* arcData, const u32 arcSize) {
 }
 
 void SzArchive::buildFileIndex() {
+	if (db.NumFiles == 0) {
+		return;
+	}
+
+	// FileNameOffsets counts UTF-16 units, terminators included, which also bounds
+	// the UTF-8 size: the whole index takes a handful of allocations
+	const size_t totalUnits = db.FileNameOffsets[db.NumFiles];
+	names.resize(UTF8_MAX_SIZE(totalUnits));
+	nameOffsets.resize(db.NumFiles);
+	sortedFiles.reserve(db.NumFiles);
+
+	size_t used = 0;
 	for (u32 i = 0; i < db.NumFiles; ++i) {
-		// Skip directories
-		unsigned isDir = SzArEx_IsDir(&db, i);
-		if (isDir) {
-			continue;
-		}
+		// Names are stored as UTF-16LE, same as the 3DS (and the hosts we build tools on)
+		const u16* name = (const u16*)(const void*)(db.FileNames + db.FileNameOffsets[i] * 2);
+		const size_t len = db.FileNameOffsets[i + 1] - db.FileNameOffsets[i];
+		nameOffsets[i] = used;
+		used += utf16ToUtf8(&names[used], name, len > 0 ? len - 1 : 0);
+		names[used++] = '\0';
 
-		// Get name
-		size_t len;
-		len = SzArEx_GetFileNameUtf16(&db, i, NULL);
-		// Super long filename? Just skip it..
-		if (len >= 256) {
-			continue;
+		if (!SzArEx_IsDir(&db, i)) {
+			sortedFiles.push_back(i);
 		}
-		u16 name[256] = { 0 };
-		SzArEx_GetFileNameUtf16(&db, i, name);
+	}
+	names.resize(used);
+	names.shrink_to_fit();
 
-		// Convert name to ASCII (just cut the other bytes)
-		char name8[256] = { 0 };
-		for (size_t j = 0; j < len; ++j) {
-			name8[j] = name[j] % 0xff;
-		}
+	std::sort(sortedFiles.begin(), sortedFiles.end(), [this](const u32 a, const u32 b) {
+		return std::strcmp(fileName(a), fileName(b)) < 0;
+	});
+}
 
-		std::string nameStr(name8);
-		files[nameStr] = i;
+u32 SzArchive::findFile(const std::string& name) const {
+	auto it = std::lower_bound(sortedFiles.begin(), sortedFiles.end(), name, [this](const u32 index, const std::string& key) {
+		return std::strcmp(fileName(index), key.c_str()) < 0;
+	});
+	if (it == sortedFiles.end() || name != fileName(*it)) {
+		return UINT32_MAX;
 	}
+	return *it;
 }
 
 SzArchive::~SzArchive() {
-	SzArEx_Free(&db, &allocImp);
+	SzArEx_Free(&db, &arena.alloc);
+	SzArena_Free(&arena);
+	SzArena_Free(&tempArena);
+}
+
+std::vector<ArchiveEntry> SzArchive::entries() {
+	std::vector<ArchiveEntry> list;
+	list.reserve(db.NumFiles);
+	for (u32 i = 0; i < db.NumFiles; ++i) {
+		// Directories and empty files map to (UInt32)-1, same as NoBlock
+		list.push_back(ArchiveEntry{ fileName(i), (size_t)SzArEx_GetFileSize(&db, i), SzArEx_IsDir(&db, i) != 0, db.FileToFolder[i] });
+	}
+	return list;
+}
+
+static std::string coderName(const UInt32 methodID) {
+	switch (methodID) {
+	case 0x00:      return "Copy";
+	case 0x03:      return "Delta";
+	case 0x21:      return "LZMA2";
+	case 0x30101:   return "LZMA";
+	case 0x3030103: return "BCJ";
+	case 0x303011B: return "BCJ2";
+	case 0x3030501: return "ARM";
+	case 0x3030701: return "ARMT";
+	default:
+		char hex[16];
+		std::snprintf(hex, sizeof(hex), "0x%lX", (unsigned long)methodID);
+		return hex;
+	}
+}
+
+std::vector<ArchiveBlock> SzArchive::blocks() {
+	std::vector<ArchiveBlock> list;
+	list.reserve(db.db.NumFolders);
+	for (u32 i = 0; i < db.db.NumFolders; ++i) {
+		CSzFolder folder;
+		CSzData sd;
+		sd.Data = db.db.CodersData + db.db.FoCodersOffsets[i];
+		sd.Size = db.db.FoCodersOffsets[i + 1] - db.db.FoCodersOffsets[i];
+
+		std::string coders;
+		if (SzGetNextFolderItem(&folder, &sd) != SZ_OK) {
+			coders = "(unsupported)";
+		} else {
+			for (u32 c = 0; c < folder.NumCoders; ++c) {
+				coders += (c > 0 ? " + " : "") + coderName(folder.Coders[c].MethodID);
+			}
+		}
+
+		UInt64 packStart = db.db.PackPositions[db.db.FoStartPackStreamIndex[i]];
+		UInt64 packEnd = db.db.PackPositions[db.db.FoStartPackStreamIndex[i + 1]];
+		list.push_back(ArchiveBlock{
+			coders,
+			(size_t)(packEnd - packStart),
+			(size_t)SzAr_GetFolderUnpackSize(&db.db, i),
+			0
+		});
+	}
+	for (u32 i = 0; i < db.NumFiles; ++i) {
+		if (db.FileToFolder[i] != ArchiveEntry::NoBlock) {
+			list[db.FileToFolder[i]].fileCount++;
+		}
+	}
+	return list;
 }
 
-void SzArchive::extractFile(std::string name, u8** fileData, size_t* fileSize, size_t* offset) {
-	auto it = files.find(name);
-	if (it == files.end()) {
+ArchiveBuffer SzArchive::extractFile(const std::string& name) {
+	const u32 fileIndex = findFile(name);
+	if (fileIndex == UINT32_MAX) {
 		throw std::runtime_error("Could not find " + name);
 	}
 
-	UInt32 blockIndex = UINT32_MAX;
-	size_t fileBufSize = 0;
+	// SzArEx_Extract frees the buffer it is given when switching blocks, only hand it
+	// the previous block when it's the right one (it then skips decoding entirely)
+	bool sameBlock = lastBlock && db.FileToFolder[fileIndex] == lastBlockIndex;
+	UInt32 blockIndex = sameBlock ? lastBlockIndex : UINT32_MAX;
+	Byte* block = sameBlock ? lastBlock.get() : nullptr;
+	size_t blockSize = sameBlock ? lastBlockSize : 0;
+	size_t offset = 0;
+	size_t fileSize = 0;
+
+	// Track this extraction's peak separately, then fold it back into the archive's
+	size_t archivePeak = tempArena.peak;
+	tempArena.peak = tempArena.used;
 
 	SRes res = SzArEx_Extract(
 		&db,
 		&memStream.s,
-		it->second,
+		fileIndex,
 		&blockIndex,
-		fileData,
-		&fileBufSize,
-		offset,
-		fileSize,
-		&allocImp,
-		&allocTempImp
+		&block,
+		&blockSize,
+		&offset,
+		&fileSize,
+		&allocOutImp,
+		&tempArena.alloc
 	);
+	SzArena_Reset(&tempArena);
+	lastPeak = tempArena.peak + blockSize;
+	tempArena.peak = std::max(archivePeak, tempArena.peak);
+
+	if (!sameBlock) {
+		// Empty files come back without a block, failed decodes must not be reused
+		lastBlock = block != nullptr ? std::shared_ptr<u8>(block, std::free) : std::shared_ptr<u8>();
+		lastBlockIndex = res == SZ_OK ? blockIndex : UINT32_MAX;
+		lastBlockSize = blockSize;
+	}
 	if (res != SZ_OK) {
 		throw std::runtime_error("Could not extract " + name);
 	}
-}
\ No newline at end of file
+
+	ArchiveBuffer file;
+	file.base = lastBlock;
+	file.data = lastBlock.get() + offset;
+	file.size = fileSize;
+	return file;
+}
@@ -12,32 +12,142 @@
 #include "minizip/ioapi_mem.h"
 #include "minizip/unzip.h"
 
-class ZipArchive {
+struct ArchiveEntry {
+	static const u32 NoBlock = UINT32_MAX;
+
+	std::string name;  /*!< Full path inside the archive                       */
+	size_t      size;  /*!< Unpacked size in bytes                             */
+	bool        isDir; /*!< Is the entry a directory?                          */
+	u32         block; /*!< Index of the block holding the entry, or NoBlock   */
+};
+
+/*! \brief Unit of compressed data, decoded as a whole
+ *
+ * A 7z folder (solid block) can hold many entries, every zip entry is its own block.
+ */
+struct ArchiveBlock {
+	std::string coders;       /*!< Coder chain in archive order (eg. "ARM + LZMA") */
+	size_t      packedSize;   /*!< Compressed size in bytes                        */
+	size_t      unpackedSize; /*!< Decoded size in bytes                           */
+	u32         fileCount;    /*!< Number of entries in the block                  */
+};
+
+/*! \brief Bytes of an extracted file
+ *
+ * `data` may point into the middle of `base` (7z decodes whole solid blocks), this is
+ * how extraction avoids copying the file out of the block. Files extracted from the
+ * same block share it, it is freed once the last buffer pointing into it goes away.
+ */
+struct ArchiveBuffer {
+	std::shared_ptr<u8> base;           /*!< Allocation holding the file    */
+	u8*                 data = nullptr; /*!< First byte of the file         */
+	size_t              size = 0;       /*!< Size of the file in bytes      */
+};
+
+class Archive {
+public:
+	virtual ~Archive() {}
+
+	/*! \brief Lists every entry (files and directories) in the archive */
+	virtual std::vector<ArchiveEntry> entries() = 0;
+
+	/*! \brief Checks wether a file (not a directory) exists in the archive
+	 *
+	 * \param name Full path of the file inside the archive
+	 */
+	virtual bool contains(const std::string& name) = 0;
+
+	/*! \brief Extracts a single file
+	 * Extracting several files from the same 7z block in a row only decodes it once.
+	 *
+	 * \param name Full path of the file inside the archive
+	 *
+	 * \return Buffer holding the file's bytes, throws std::runtime_error on failure
+	 */
+	virtual ArchiveBuffer extractFile(const std::string& name) = 0;
+
+	/*! \brief Lists the compressed blocks of the archive, indexed by ArchiveEntry::block */
+	virtual std::vector<ArchiveBlock> blocks() = 0;
+
+	/*! \brief Peak memory used by the last extractFile call, output buffer included (bytes) */
+	virtual size_t lastPeakMemory() const = 0;
+
+	/*! \brief Highest amount of memory held at once by decoders (bytes, 0 if not tracked) */
+	virtual size_t peakMemory() const { return 0; }
+
+	/*! \brief Number of allocations made by decoders (0 if not tracked) */
+	virtual u32 allocCount() const { return 0; }
+
+	/*! \brief Opens an in-memory archive, picking the format from its signature
+	 *
+	 * The archive data is not copied and must outlive the returned object.
+	 *
+	 * \param arcData Archive bytes
+	 * \param arcSize Size of the archive in bytes
+	 *
+	 * \return Opened archive, throws std::runtime_error if the format is not recognized
+	 */
+	static std::unique_ptr<Archive> open(const u8* arcData, const u32 arcSize);
+};
+
+class ZipArchive : public Archive {
 private:
 	ourmemory_t unzmem = {};
 	zlib_filefunc_def filefunc32 = {};
 	unzFile zipfile = nullptr;
+	size_t lastPeak = 0;
+
+	void scan(std::vector<ArchiveEntry>* entryList, std::vector<ArchiveBlock>* blockList);
 
 public:
 	ZipArchive(const u8* arcData, const u32 arcSize);
 	~ZipArchive();
 
-	void extractFile(std::string name, u8** fileData, size_t* fileSize);
+	std::vector<ArchiveEntry> entries() override;
+	bool contains(const std::string& name) override;
+	ArchiveBuffer extractFile(const std::string& name) override;
+	std::vector<ArchiveBlock> blocks() override;
+	size_t lastPeakMemory() const override { return lastPeak; }
 };
 
-class SzArchive {
+class SzArchive : public Archive {
 private:
 	CMemInStream memStream;
 	CSzArEx db;
-	ISzAlloc allocImp;
-	ISzAlloc allocTempImp;
 
-	std::map<std::string, u32> files;
+	// Header arrays live in `arena` until the archive is destroyed, decoder
+	// scratch lives in `tempArena` and is reset after every open/extract.
+	// Extracted buffers are handed to the caller, so they come from malloc.
+	CSzArena arena;
+	CSzArena tempArena;
+	CSzArenaTotal arenaTotal = {};
+	ISzAlloc allocOutImp;
+	size_t lastPeak = 0;
+
+	// Last decoded block, reused when the next file lives in the same one
+	std::shared_ptr<u8> lastBlock;
+	UInt32 lastBlockIndex = UINT32_MAX;
+	size_t lastBlockSize = 0;
+
+	// Every entry name (UTF-8, NUL-terminated) interned in one buffer, plus the
+	// indexes of all non-directory entries sorted by name for lookups
+	std::vector<char> names;
+	std::vector<u32> nameOffsets;
+	std::vector<u32> sortedFiles;
 	void buildFileIndex();
+	const char* fileName(const u32 index) const { return &names[nameOffsets[index]]; }
+	u32 findFile(const std::string& name) const;
 
 public:
 	SzArchive(const u8* arcData, const u32 arcSize);
 	~SzArchive();
 
-	void extractFile(std::string name, u8** fileData, size_t* fileSize, size_t* offset);
-};
\ No newline at end of file
+	std::vector<ArchiveEntry> entries() override;
+	bool contains(const std::string& name) override { return findFile(name) != UINT32_MAX; }
+	ArchiveBuffer extractFile(const std::string& name) override;
+	std::vector<ArchiveBlock> blocks() override;
+	size_t lastPeakMemory() const override { return lastPeak; }
+
+	size_t peakMemory() const override { return arenaTotal.peak; }
+	u32 allocCount() const override { return arena.numAllocs + tempArena.numAllocs; }
+};
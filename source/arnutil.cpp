@@ -1,5 +1,6 @@
 #include "arnutil.h"
 
+#include "unicode.h"
 #include "utils.h"
 
 bool renameRecursive(const FS_Archive& archive, const std::string& source, const std::string& target);
@@ -76,8 +77,11 @@ bool arnMigrate() {
 }
 
 bool renameRecursive(const FS_Archive& archive, const std::string& source, const std::string& target) {
-	const FS_Path sourcePath = fsMakePath(PATH_ASCII, source.c_str());
-	const FS_Path targetPath = fsMakePath(PATH_ASCII, target.c_str());
+	// Names may not be ASCII, go through UTF-16 paths
+	const std::u16string source16 = utf8ToUtf16(source);
+	const std::u16string target16 = utf8ToUtf16(target);
+	const FS_Path sourcePath = fsMakePath(PATH_UTF16, source16.c_str());
+	const FS_Path targetPath = fsMakePath(PATH_UTF16, target16.c_str());
 
 	// Open source directory
 	Handle directory = 0;
@@ -100,12 +104,7 @@ bool renameRecursive(const FS_Archive& archive, const std::string& source, const
 			break;
 		}
 
-		// Convert name to ASCII (just cut the other bytes)
-		char name8[262] = { 0 };
-		for (size_t i = 0; i < 262; i++) {
-			name8[i] = entry.name[i] % 0xff;
-		}
-		std::string filePath = std::string("/") + name8;
+		std::string filePath = "/" + utf16ToUtf8(entry.name, utf16Length(entry.name, 262));
 		std::string from = source + filePath;
 		std::string to = target + filePath;
 
@@ -116,13 +115,15 @@ bool renameRecursive(const FS_Archive& archive, const std::string& source, const
 				return false;
 			}
 		} else {
-			FS_Path sourceFilePath = fsMakePath(PATH_ASCII, from.c_str());
-			FS_Path targetFilePath = fsMakePath(PATH_ASCII, to.c_str());
+			const std::u16string from16 = utf8ToUtf16(from);
+			const std::u16string to16 = utf8ToUtf16(to);
+			FS_Path sourceFilePath = fsMakePath(PATH_UTF16, from16.c_str());
+			FS_Path targetFilePath = fsMakePath(PATH_UTF16, to16.c_str());
 			if (FSUSER_RenameFile(archive, sourceFilePath, archive, targetFilePath) != 0) {
-				logPrintf("\nCould not rename %s\n\n", (char*)sourceFilePath.data);
+				logPrintf("\nCould not rename %s\n\n", from.c_str());
 				return false;
 			}
-			logPrintf("  %s -> %s\n", (char*)sourceFilePath.data, (char*)targetFilePath.data);
+			logPrintf("  %s -> %s\n", from.c_str(), to.c_str());
 		}
 	}
 
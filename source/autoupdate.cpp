@@ -1,12 +1,12 @@
 #include "autoupdate.h"
 
-// jsmn includes
-#include "jsmn.h"
-
 // Internal includes
 #include "archive.h"
 #include "console.h"
+#include "digest.h"
 #include "http.h"
+#include "github.h"
+#include "sdwriter.h"
 #include "utils.h"
 
 UpdaterInfo updaterGetInfo(const char* path) {
@@ -49,74 +49,45 @@ UpdaterInfo updaterGetInfo(const char* path) {
 	return { type, location, sdmcLoc, smdcName };
 }
 
-#ifndef FAKEDL
-static int jsoneq(const char *json, jsmntok_t *tok, const char *s) {
-	if (tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start &&
-		std::strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
-		return 0;
-	}
-	return -1;
-}
-#endif
-
 LatestUpdaterInfo updaterGetLatest() {
 #ifdef FAKEDL
 	return {};
 #else
 	static const char* ReleaseURL = "https://api.github.com/repos/KunoichiZ/lumaupdate/releases/latest";
 
-	jsmn_parser p = {};
-	jsmn_init(&p);
-
-	u8* apiReqData = nullptr;
 	u32 apiReqSize = 0;
 
 	logPrintf("Downloading %s...\n", ReleaseURL);
 
-	httpGet(ReleaseURL, &apiReqData, &apiReqSize, true);
+	// Parsed as it comes in, see GitHubReleaseReader
+	GitHubRelease github;
+	GitHubReleaseReader reader(&github);
+	httpGetStream(ReleaseURL, [&reader](const u8* data, const u32 size) {
+		reader.feed(data, size);
+	}, &apiReqSize, true);
 
 	logPrintf("Downloaded %lu bytes\n", apiReqSize);
 	gfxFlushBuffers();
 
-	jsmntok_t t[512] = {};
-	int r = jsmn_parse(&p, (const char*)apiReqData, apiReqSize, t, sizeof(t) / sizeof(t[0]));
-	if (r < 0) {
-		throw formatErrMessage("Failed to parse JSON", r);
+	if (!reader.finish()) {
+		throw std::string("Failed to parse JSON");
 	}
 	logPrintf("JSON parsed successfully!\n");
-	gfxFlushBuffers();
 
-	bool namefound = false, bodyfound = false, inassets = false;
 	LatestUpdaterInfo latest;
-	for (int i = 0; i < r; i++) {
-		if (!namefound && jsoneq((const char*)apiReqData, &t[i], "tag_name") == 0) {
-			jsmntok_t val = t[i + 1];
-			latest.version = std::string((const char*)apiReqData + val.start, val.end - val.start);
-			logPrintf("Release found: %s\n", latest.version.c_str());
-			namefound = true;
-		}
-		if (!bodyfound && jsoneq((const char*)apiReqData, &t[i], "body") == 0) {
-			jsmntok_t val = t[i + 1];
-			latest.changelog = unescape(std::string((const char*)apiReqData + val.start, val.end - val.start));
-			logPrintf("Changelog found.\n");
-			bodyfound = true;
-		}
-		if (!inassets && jsoneq((const char*)apiReqData, &t[i], "assets") == 0) {
-			inassets = true;
-		}
-		if (inassets) {
-			if (jsoneq((const char*)apiReqData, &t[i], "browser_download_url") == 0) {
-				jsmntok_t val = t[i + 1];
-				std::string url = std::string((const char*)apiReqData + val.start, val.end - val.start);
-				if (url.find(".zip") != std::string::npos) {
-					latest.url = url;
-				}
-			}
+	latest.version = github.tagName;
+	logPrintf("Release found: %s\n", latest.version.c_str());
+	latest.changelog = github.body;
+	if (!latest.changelog.empty()) {
+		logPrintf("Changelog found.\n");
+	}
+	for (const GitHubAsset& asset : github.assets) {
+		if (asset.url.find(".zip") != std::string::npos) {
+			latest.url = asset.url;
+			latest.fileSize = asset.size;
 		}
 	}
-
 	gfxFlushBuffers();
-	std::free(apiReqData);
 
 #ifdef GIT_VER
 	latest.isNewer = latest.version > GIT_VER;
@@ -142,10 +113,10 @@ static void installCIA(const u8* ciaData, const size_t ciaSize) {
 	}
 }
 
-static void copyToFile(const std::string& path, const u8* fileData, const size_t fileSize) {
-	std::ofstream fout(path, std::ios::binary | std::ios::out);
-	fout.write((const char*)fileData, fileSize);
-	fout.close();
+static void copyToFile(SdWriter& sd, const std::string& path, const ArchiveBuffer& file) {
+	if (!sd.replace(path, file.data, file.size)) {
+		throw std::runtime_error("Could not write " + path);
+	}
 }
 
 UpdateResult updaterDoUpdate(LatestUpdaterInfo latest, UpdaterInfo current) {
@@ -158,10 +129,22 @@ UpdateResult updaterDoUpdate(LatestUpdaterInfo latest, UpdaterInfo current) {
 	u8* archiveData = nullptr;
 	u32 archiveSize = 0;
 	HTTPResponseInfo info;
+	Digest digest;
 
 	try {
 		logPrintf("Downloading %s...\n", latest.url.c_str());
-		httpGet(latest.url.c_str(), &archiveData, &archiveSize, true, &info);
+		// The archive is small, hashing it as it comes in doesn't need its own thread
+		bool started = false;
+		httpGet(latest.url.c_str(), &archiveData, &archiveSize, true, &info, [&digest, &started, &info, &archiveSize](const u8* data, const u32 size) {
+			if (!started) {
+				ExpectedDigest etag;
+				if (digestParse(info.etag, "ETag", &etag)) {
+					digest.trackParts(etag, archiveSize);
+				}
+				started = true;
+			}
+			digest.update(data, size);
+		});
 		logPrintf("Download complete! Size: %lu\n", archiveSize);
 	} catch (const std::runtime_error& e) {
 		logPrintf("\nFATAL: %s", e.what());
@@ -172,15 +155,16 @@ UpdateResult updaterDoUpdate(LatestUpdaterInfo latest, UpdaterInfo current) {
 	consoleSetProgressData("Checking archive integrity", 0.5);
 	consoleScreen(GFX_BOTTOM);
 
-	if (!info.etag.empty()) {
+	ExpectedDigest expected;
+	if (!info.etag.empty() && digestParse(info.etag, "ETag", &expected)) {
 		logPrintf("Performing integrity check... ");
-		if (!httpCheckETag(info.etag, archiveData, archiveSize)) {
-			logPrintf(" ERR\nMD5 mismatch between server's and local file!\n");
+		if (!digestMatches(digest.finish(), expected)) {
+			logPrintf(" ERR\n%s mismatch between server's and local file!\n", digestName(expected.type));
 			return { false, "DOWNLOAD FAILED" };
 		}
 		logPrintf(" OK\n");
 	} else {
-		logPrintf("Skipping integrity check (no ETag found)\n");
+		logPrintf("Skipping integrity check (no usable ETag found)\n");
 	}
 
 	consoleScreen(GFX_TOP);
@@ -191,48 +175,41 @@ UpdateResult updaterDoUpdate(LatestUpdaterInfo latest, UpdaterInfo current) {
 		ZipArchive archive(archiveData, archiveSize);
 
 		switch (current.type) {
-		case HomebrewType::CIA:
+		case HomebrewType::CIA: {
 			// Extract CIA from archive, install it
-			u8* ciaData;
-			size_t ciaSize;
 			logPrintf("Extracting lumaupdater.cia");
-			archive.extractFile("lumaupdater.cia", &ciaData, &ciaSize);
-			logPrintf(" [OK] (%u bytes)\n", ciaSize);
+			const ArchiveBuffer cia = archive.extractFile("lumaupdater.cia");
+			logPrintf(" [OK] (%u bytes)\n", cia.size);
 			try {
 				logPrintf("Installing lumaupdater.cia");
-				installCIA(ciaData, ciaSize);
+				installCIA(cia.data, cia.size);
 				logPrintf(" [OK]\n");
 			} catch (const std::runtime_error& e) {
 				logPrintf(" [ERR]\n\nFATAL: %s", e.what());
 				return { false, "CIA INSTALL FAILED" };
 			}
 			break;
+		}
 		case HomebrewType::Homebrew: {
 			// Extract 3dsx/smdh from archive
-			u8* hbData;
-			size_t hbSize;
+			SdWriter sd;
 			logPrintf("Extracting lumaupdater.3dsx");
-			archive.extractFile("3DS/lumaupdater/lumaupdater.3dsx", &hbData, &hbSize);
-			logPrintf(" [OK] (%u bytes)\n", hbSize);
-
+			const ArchiveBuffer hb = archive.extractFile("3DS/lumaupdater/lumaupdater.3dsx");
+			logPrintf(" [OK] (%u bytes)\n", hb.size);
 
 			const std::string targetHb = current.sdmcLoc + "/" + current.sdmcName + ".3dsx";
 			logPrintf("Copying to %s", targetHb.c_str());
-			copyToFile(targetHb, hbData, hbSize);
+			copyToFile(sd, targetHb, hb);
 			logPrintf(" [OK]\n");
-			std::free(hbData);
 
-			u8* smdhData;
-			size_t smdhSize;
-			logPrintf("Extracting lumaupdater.3dsx");
-			archive.extractFile("3DS/lumaupdater/lumaupdater.smdh", &smdhData, &smdhSize);
-			logPrintf(" [OK] (%u bytes)\n", smdhSize);
+			logPrintf("Extracting lumaupdater.smdh");
+			const ArchiveBuffer smdh = archive.extractFile("3DS/lumaupdater/lumaupdater.smdh");
+			logPrintf(" [OK] (%u bytes)\n", smdh.size);
 
 			const std::string targetSMDH = current.sdmcLoc + "/" + current.sdmcName + ".smdh";
 			logPrintf("Copying to %s", targetSMDH.c_str());
-			copyToFile(targetSMDH, smdhData, smdhSize);
+			copyToFile(sd, targetSMDH, smdh);
 			logPrintf(" [OK]\n");
-			std::free(smdhData);
 			break;
 		}
 		default:
@@ -0,0 +1,241 @@
+#include "blocksync.h"
+
+#include "bytes.h"
+#include "digest.h"
+
+#ifdef _3DS
+#include "http.h"
+#include "sdwriter.h"
+#include "utils.h"
+#endif
+
+// Both halves of the weak checksum, unmasked so they can be rolled (only the low 16 bits count)
+static void weakParts(const u8* data, const u32 size, u32* a, u32* b) {
+	*a = 0;
+	*b = 0;
+	for (u32 i = 0; i < size; i++) {
+		*a += data[i];
+		*b += *a;
+	}
+}
+
+static u32 weakJoin(const u32 a, const u32 b) {
+	return (a & 0xffff) | (b << 16);
+}
+
+u32 blockSyncWeak(const u8* data, const u32 size) {
+	u32 a, b;
+	weakParts(data, size, &a, &b);
+	return weakJoin(a, b);
+}
+
+std::vector<u8> blockSyncMake(const u8* data, const u32 size, const u32 blockSize) {
+	std::vector<u8> out(BLOCKSYNC_MAGIC, BLOCKSYNC_MAGIC + 4);
+	putU32LE(out, blockSize);
+	putU32LE(out, size);
+	out.resize(BLOCKSYNC_HEADER_SIZE);
+	digestSHA256(data, size, &out[BLOCKSYNC_HEADER_SIZE - 32]);
+
+	for (u32 offset = 0; offset < size; offset += blockSize) {
+		const u32 length = std::min(blockSize, size - offset);
+		u8 strong[32];
+		digestSHA256(data + offset, length, strong);
+		putU32LE(out, blockSyncWeak(data + offset, length));
+		out.insert(out.end(), strong, strong + BLOCKSYNC_STRONG_SIZE);
+	}
+	return out;
+}
+
+bool blockSyncParse(const u8* data, const size_t size, BlockSums* sums) {
+	if (size < BLOCKSYNC_HEADER_SIZE || std::memcmp(data, BLOCKSYNC_MAGIC, 4) != 0) {
+		return false;
+	}
+	sums->blockSize = readU32LE(data + 4);
+	sums->fileSize = readU32LE(data + 8);
+	if (sums->blockSize == 0) {
+		return false;
+	}
+	const u64 blocks = ((u64)sums->fileSize + sums->blockSize - 1) / sums->blockSize;
+	if (size != BLOCKSYNC_HEADER_SIZE + blocks * BLOCKSYNC_ENTRY_SIZE) {
+		return false;
+	}
+	std::memcpy(sums->fileHash, data + BLOCKSYNC_HEADER_SIZE - 32, 32);
+
+	sums->weak.clear();
+	sums->strong.clear();
+	for (const u8* entry = data + BLOCKSYNC_HEADER_SIZE; entry < data + size; entry += BLOCKSYNC_ENTRY_SIZE) {
+		sums->weak.push_back(readU32LE(entry));
+		sums->strong.insert(sums->strong.end(), entry + 4, entry + BLOCKSYNC_ENTRY_SIZE);
+	}
+	return true;
+}
+
+// Copies the block if `data` has its strong checksum
+static bool matchBlock(const BlockSums& sums, const u32 block, const u8* data, u8* target, std::vector<bool>* found) {
+	const u32 length = sums.blockLength(block);
+	u8 strong[32];
+	digestSHA256(data, length, strong);
+	if (std::memcmp(strong, &sums.strong[block * BLOCKSYNC_STRONG_SIZE], BLOCKSYNC_STRONG_SIZE) != 0) {
+		return false;
+	}
+	std::memcpy(target + block * sums.blockSize, data, length);
+	(*found)[block] = true;
+	return true;
+}
+
+u32 blockSyncMatch(const BlockSums& sums, const u8* local, const size_t localSize, u8* target, std::vector<bool>* found) {
+	const u32 blockSize = sums.blockSize;
+	const u32 count = sums.blockCount();
+	found->resize(count, false);
+
+	// Full blocks sorted by weak checksum, a short last block is looked for on its own
+	std::vector<std::pair<u32, u32>> index;
+	for (u32 block = 0; block < count; block++) {
+		if (!(*found)[block] && sums.blockLength(block) == blockSize) {
+			index.push_back(std::make_pair(sums.weak[block], block));
+		}
+	}
+	std::sort(index.begin(), index.end());
+
+	u32 matched = 0;
+	if (!index.empty() && localSize >= blockSize) {
+		size_t pos = 0;
+		u32 a, b;
+		weakParts(local, blockSize, &a, &b);
+		while (matched < index.size()) {
+			// Every block with this checksum is compared, the same contents can be in several places
+			bool hit = false;
+			auto range = std::equal_range(index.begin(), index.end(), std::make_pair(weakJoin(a, b), 0u),
+				[](const std::pair<u32, u32>& x, const std::pair<u32, u32>& y) { return x.first < y.first; });
+			for (auto candidate = range.first; candidate != range.second; ++candidate) {
+				if (!(*found)[candidate->second] && matchBlock(sums, candidate->second, local + pos, target, found)) {
+					hit = true;
+					matched++;
+				}
+			}
+
+			// After a match the next block most likely starts right after it
+			if (hit && pos + 2 * (size_t)blockSize <= localSize) {
+				pos += blockSize;
+				weakParts(local + pos, blockSize, &a, &b);
+				continue;
+			}
+			if (pos + blockSize >= localSize) {
+				break;
+			}
+			const u8 out = local[pos];
+			const u8 in = local[pos + blockSize];
+			a += in - out;
+			b += a - blockSize * out;
+			pos++;
+		}
+	}
+
+	// The last block usually stays at the end of the file, or where it was
+	const u32 last = count - 1;
+	const u32 lastLength = count > 0 ? sums.blockLength(last) : 0;
+	if (count > 0 && lastLength < blockSize && !(*found)[last] && localSize >= lastLength) {
+		const size_t places[] = { localSize - lastLength, (size_t)last * blockSize };
+		for (const size_t place : places) {
+			if (place + lastLength <= localSize && blockSyncWeak(local + place, lastLength) == sums.weak[last] &&
+				matchBlock(sums, last, local + place, target, found)) {
+				matched++;
+				break;
+			}
+		}
+	}
+	return matched;
+}
+
+std::vector<std::pair<u32, u32>> blockSyncRanges(const BlockSums& sums, const std::vector<bool>& found) {
+	std::vector<std::pair<u32, u32>> ranges;
+	for (u32 block = 0; block < sums.blockCount(); block++) {
+		if (block < found.size() && found[block]) {
+			continue;
+		}
+		const u32 offset = block * sums.blockSize;
+		const u32 end = offset + sums.blockLength(block);
+		if (!ranges.empty() && offset - (ranges.back().first + ranges.back().second) <= BLOCKSYNC_MAX_GAP * sums.blockSize) {
+			ranges.back().second = end - ranges.back().first;
+		} else {
+			ranges.push_back(std::make_pair(offset, end - offset));
+		}
+	}
+	return ranges;
+}
+
+#ifdef _3DS
+
+bool blockSyncGetPayload(const std::string& mirror, const ReleaseVer& release, const std::string& payloadName, const std::string& installedPath, ArchiveBuffer* payload) {
+	const std::string url = mirror + (mirror.empty() || mirror.back() != '/' ? "/" : "") + release.filename + "/" + payloadName;
+
+	u8* sumsData = nullptr;
+	u32 sumsSize = 0;
+	try {
+		httpGet((url + BLOCKSYNC_SUFFIX).c_str(), &sumsData, &sumsSize);
+	} catch (const std::runtime_error& e) {
+		logPrintf("Could not get block checksums: %s\n", e.what());
+		std::free(sumsData);
+		return false;
+	}
+	BlockSums sums;
+	const bool parsed = blockSyncParse(sumsData, sumsSize, &sums);
+	std::free(sumsData);
+	if (!parsed) {
+		logPrintf("Block checksum file is malformed\n");
+		return false;
+	}
+
+	std::shared_ptr<u8> target((u8*)std::malloc(std::max<size_t>(sums.fileSize, 1)), std::free);
+	if (!target) {
+		logPrintf("Could not allocate %u bytes\n", (unsigned)sums.fileSize);
+		return false;
+	}
+
+	// The backup is usually the release before the installed one, it can have blocks the installed one lost
+	std::vector<bool> found(sums.blockCount(), false);
+	try {
+		SdWriter writer;
+		for (const std::string& path : { installedPath, installedPath + ".bak" }) {
+			std::shared_ptr<u8> local;
+			u64 localSize = 0;
+			if (writer.readFile(path, &local, &localSize)) {
+				const u32 matched = blockSyncMatch(sums, local.get(), localSize, target.get(), &found);
+				logPrintf("Found %u of %u blocks in %s\n", (unsigned)matched, (unsigned)sums.blockCount(), path.c_str());
+			}
+		}
+	} catch (const std::runtime_error& e) {
+		logPrintf("%s\n", e.what());
+	}
+
+	const std::vector<std::pair<u32, u32>> ranges = blockSyncRanges(sums, found);
+	u32 fetched = 0;
+	for (const auto& range : ranges) {
+		fetched += range.second;
+	}
+	logPrintf("Downloading %u bytes in %u range(s) from %s\n", (unsigned)fetched, (unsigned)ranges.size(), url.c_str());
+	gfxFlushBuffers();
+	try {
+		for (const auto& range : ranges) {
+			httpGetRange(url.c_str(), range.first, range.second, target.get() + range.first);
+		}
+	} catch (const std::runtime_error& e) {
+		logPrintf("Could not download missing blocks: %s\n", e.what());
+		return false;
+	}
+
+	u8 hash[32];
+	digestSHA256(target.get(), sums.fileSize, hash);
+	if (std::memcmp(hash, sums.fileHash, sizeof(hash)) != 0) {
+		logPrintf("Synced payload doesn't match its checksum\n");
+		return false;
+	}
+
+	logPrintf("Synced payload (%u of %u bytes downloaded)\n", (unsigned)fetched, (unsigned)sums.fileSize);
+	payload->base = target;
+	payload->data = target.get();
+	payload->size = sums.fileSize;
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "libs.h"
+
+#include "archive.h"
+#include "release.h"
+
+/* Block checksum files ("LUB1"), published next to an uncompressed payload as
+ * "<payload url>" BLOCKSYNC_SUFFIX. All integers little endian:
+ *
+ *   magic      4 bytes  "LUB1"
+ *   blockSize  u32
+ *   fileSize   u32
+ *   fileHash   32 bytes SHA-256 of the whole payload
+ *   blocks     ceil(fileSize / blockSize) times:
+ *     weak     u32      rolling checksum (see blockSyncWeak)
+ *     strong   BLOCKSYNC_STRONG_SIZE bytes, start of the block's SHA-256
+ *
+ * The last block can be shorter than blockSize, its checksums only cover its own bytes.
+ */
+#define BLOCKSYNC_MAGIC         "LUB1"
+#define BLOCKSYNC_SUFFIX        ".blocks"
+#define BLOCKSYNC_HEADER_SIZE   (4 + 4 + 4 + 32)
+#define BLOCKSYNC_STRONG_SIZE   16
+#define BLOCKSYNC_ENTRY_SIZE    (4 + BLOCKSYNC_STRONG_SIZE)
+// Default block size of lumaupdate-blocks, payloads change in small scattered places
+#define BLOCKSYNC_DEFAULT_BLOCK 1024
+// Blocks already found that still get downloaded to join two missing runs in a single request
+#define BLOCKSYNC_MAX_GAP       4
+
+/*! \brief Checksums of every block of a payload, from a block checksum file */
+struct BlockSums {
+	u32              blockSize    = 0;
+	u32              fileSize     = 0;
+	u8               fileHash[32] = {};
+	std::vector<u32> weak;   //!< One per block
+	std::vector<u8>  strong; //!< BLOCKSYNC_STRONG_SIZE bytes per block
+
+	u32 blockCount() const { return weak.size(); }
+	u32 blockLength(const u32 block) const { return std::min(blockSize, fileSize - block * blockSize); }
+};
+
+/*! \brief rsync's weak checksum: sum of the bytes and sum of the running sums, 16 bits each */
+u32 blockSyncWeak(const u8* data, const u32 size);
+
+/*! \brief Makes the block checksum file of a payload
+ *
+ * \param data      Payload contents
+ * \param size      Payload size in bytes
+ * \param blockSize Block size in bytes (at least 16)
+ *
+ * \return Contents of the block checksum file
+ */
+std::vector<u8> blockSyncMake(const u8* data, const u32 size, const u32 blockSize);
+
+/*! \brief Parses a block checksum file
+ *
+ * \param data Block checksum file contents
+ * \param size Size of the file in bytes
+ * \param sums Checksums to fill
+ *
+ * \return true if the file is well formed, false otherwise
+ */
+bool blockSyncParse(const u8* data, const size_t size, BlockSums* sums);
+
+/*! \brief Finds blocks of the new payload in a local file
+ *
+ * The weak checksum is rolled over every offset of the local file, blocks can be found
+ * anywhere in it (moved code still matches). Weak matches are confirmed with the strong
+ * checksum before the block gets copied.
+ *
+ * \param sums      Checksums of the new payload
+ * \param local     Local file contents (eg. the installed payload)
+ * \param localSize Local file size in bytes
+ * \param target    New payload being built, sums.fileSize bytes
+ * \param found     One flag per block, set for every block copied to target
+ *
+ * \return Number of blocks found that weren't already
+ */
+u32 blockSyncMatch(const BlockSums& sums, const u8* local, const size_t localSize, u8* target, std::vector<bool>* found);
+
+/*! \brief Groups the blocks still missing in ranges to download
+ *  Runs closer than BLOCKSYNC_MAX_GAP blocks are joined, fewer requests beat a few KiB.
+ *
+ * \param sums  Checksums of the new payload
+ * \param found Blocks already found
+ *
+ * \return (offset, length) of every range to download, in bytes
+ */
+std::vector<std::pair<u32, u32>> blockSyncRanges(const BlockSums& sums, const std::vector<bool>& found);
+
+#ifdef _3DS
+/*! \brief Gets a payload by downloading only the blocks the installed one doesn't have
+ *
+ * The mirror layout is "<mirror>/<release file name>/<payload path>" for the uncompressed
+ * payload, plus BLOCKSYNC_SUFFIX for its block checksum file. The installed payload and
+ * its backup are searched for blocks, the rest is fetched with Range requests. Callers
+ * fall back to downloading the whole release when this fails.
+ *
+ * \param mirror        Base URL of the mirror
+ * \param release       Release to get the payload of
+ * \param payloadName   Payload path inside the release archive (eg. DEFAULT_A9LH_PATH)
+ * \param installedPath Path of the installed payload
+ * \param payload       Buffer to fill with the payload bytes
+ *
+ * \return true if the payload was rebuilt and verified, false otherwise
+ */
+bool blockSyncGetPayload(const std::string& mirror, const ReleaseVer& release, const std::string& payloadName, const std::string& installedPath, ArchiveBuffer* payload);
+#endif
\ No newline at end of file
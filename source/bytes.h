@@ -0,0 +1,17 @@
+#pragma once
+
+#include "libs.h"
+
+// Little endian integers, as stored in delta patches (deltaupdate.h) and block sums (blocksync.h)
+
+/*! \brief Reads a little endian u32 */
+inline u32 readU32LE(const u8* data) {
+	return (u32)data[0] | ((u32)data[1] << 8) | ((u32)data[2] << 16) | ((u32)data[3] << 24);
+}
+
+/*! \brief Appends a little endian u32 */
+inline void putU32LE(std::vector<u8>& out, const u32 value) {
+	for (u32 i = 0; i < 4; i++) {
+		out.push_back((u8)(value >> (i * 8)));
+	}
+}
\ No newline at end of file
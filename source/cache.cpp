@@ -0,0 +1,264 @@
+#include "cache.h"
+
+#include "digest.h"
+#include "sdwriter.h"
+#include "utils.h"
+
+// Index name of the release archive itself (payloads use their path inside it)
+#define CACHE_ARCHIVE_NAME "*"
+
+static u64 cacheBudget = CACHE_DEFAULT_SIZE;
+
+/* Index lines are "<release>\t<name>\t<sha256>\t<size>\t<last use>". Last use is a counter
+   bumped on every cache hit or store, the clock can't be trusted to only go forward. */
+struct CacheEntry {
+	std::string release;
+	std::string name;
+	std::string hash;
+	u64         size;
+	u64         lastUse;
+};
+
+void cacheSetBudget(const u64 bytes) {
+	cacheBudget = bytes;
+}
+
+// Release key: file name (sanitized) plus a short URL hash,
+// so the same file name from two different sources doesn't collide
+static std::string cacheReleaseKey(const ReleaseVer& release) {
+	std::string key;
+	for (char c : release.filename) {
+		key += std::isalnum((unsigned char)c) || c == '.' || c == '-' || c == '_' ? c : '_';
+	}
+	key += "-" + digestSHA256Hex((const u8*)release.url.c_str(), release.url.length()).substr(0, 8);
+	return key;
+}
+
+static std::string cacheObjectPath(const std::string& hash) {
+	return std::string(CACHE_OBJECTS_DIR) + "/" + hash;
+}
+
+static std::vector<CacheEntry> cacheLoadIndex() {
+	std::vector<CacheEntry> entries;
+	std::ifstream index(CACHE_INDEX_PATH);
+	std::string line;
+	while (std::getline(index, line)) {
+		std::istringstream fields(line);
+		CacheEntry entry;
+		std::string size, lastUse;
+		if (std::getline(fields, entry.release, '\t') && std::getline(fields, entry.name, '\t') &&
+			std::getline(fields, entry.hash, '\t') && std::getline(fields, size, '\t') && std::getline(fields, lastUse)) {
+			entry.size = std::strtoull(size.c_str(), nullptr, 10);
+			entry.lastUse = std::strtoull(lastUse.c_str(), nullptr, 10);
+			entries.push_back(entry);
+		}
+	}
+	return entries;
+}
+
+static bool cacheSaveIndex(SdWriter& writer, const std::vector<CacheEntry>& entries) {
+	std::string data;
+	for (const CacheEntry& entry : entries) {
+		data += entry.release + "\t" + entry.name + "\t" + entry.hash + "\t" + tostr(entry.size) + "\t" + tostr(entry.lastUse) + "\n";
+	}
+	return writer.replace(CACHE_INDEX_PATH, (const u8*)data.data(), data.size());
+}
+
+static u64 cacheNextUse(const std::vector<CacheEntry>& entries) {
+	u64 last = 0;
+	for (const CacheEntry& entry : entries) {
+		last = std::max(last, entry.lastUse);
+	}
+	return last + 1;
+}
+
+// Reads a cached file and checks it still hashes to its name, returns a malloc'd buffer
+static u8* cacheReadObject(SdWriter& writer, const std::string& hash, size_t* size) {
+	SdWriter::ReadHandle handle;
+	u64 fileSize = 0;
+	if (!writer.openRead(cacheObjectPath(hash), &handle, &fileSize)) {
+		return nullptr;
+	}
+
+	u8* data = (u8*)std::malloc(std::max<size_t>(fileSize, 1));
+	const bool ok = data != nullptr && writer.read(handle, 0, data, fileSize);
+	writer.closeRead(handle);
+	if (!ok || digestSHA256Hex(data, fileSize) != hash) {
+		std::free(data);
+		return nullptr;
+	}
+	*size = fileSize;
+	return data;
+}
+
+// Finds and reads a cached file, marking it as just used
+static u8* cacheGet(const ReleaseVer& release, const std::string& name, size_t* size) {
+	std::vector<CacheEntry> entries = cacheLoadIndex();
+	const std::string key = cacheReleaseKey(release);
+	auto entry = std::find_if(entries.begin(), entries.end(), [&key, &name](const CacheEntry& entry) {
+		return entry.release == key && entry.name == name;
+	});
+	if (entry == entries.end()) {
+		return nullptr;
+	}
+
+	try {
+		SdWriter writer;
+		u8* data = cacheReadObject(writer, entry->hash, size);
+		if (data == nullptr) {
+			logPrintf("Cached %s is corrupted, ignoring it\n", entry->name.c_str());
+		} else {
+			entry->lastUse = cacheNextUse(entries);
+			cacheSaveIndex(writer, entries);
+		}
+		return data;
+	} catch (const std::runtime_error& e) {
+		logPrintf("%s\n", e.what());
+		return nullptr;
+	}
+}
+
+bool cacheGetPayload(const ReleaseVer& release, const std::string& name, ArchiveBuffer* payload) {
+	size_t size = 0;
+	u8* data = cacheGet(release, name, &size);
+	if (data == nullptr) {
+		return false;
+	}
+	payload->base = std::shared_ptr<u8>(data, std::free);
+	payload->data = data;
+	payload->size = size;
+	return true;
+}
+
+bool cacheGetObject(const std::string& hash, ArchiveBuffer* file) {
+	if (hash.length() != 64 || hash.find_first_not_of("0123456789abcdef") != std::string::npos) {
+		return false;
+	}
+	try {
+		SdWriter writer;
+		size_t size = 0;
+		u8* data = cacheReadObject(writer, hash, &size);
+		if (data == nullptr) {
+			return false;
+		}
+		file->base = std::shared_ptr<u8>(data, std::free);
+		file->data = data;
+		file->size = size;
+		return true;
+	} catch (const std::runtime_error& e) {
+		logPrintf("%s\n", e.what());
+		return false;
+	}
+}
+
+bool cacheGetArchive(const ReleaseVer& release, u8** fileData, u32* fileSize) {
+	size_t size = 0;
+	*fileData = cacheGet(release, CACHE_ARCHIVE_NAME, &size);
+	*fileSize = (u32)size;
+	return *fileData != nullptr;
+}
+
+// Evicts least recently used files (never the ones used since `keepFrom`) until the cache fits
+static void cacheEvict(std::vector<CacheEntry>& entries, const u64 keepFrom) {
+	// Files can be shared between releases, they count once and live as long as their last use
+	std::map<std::string, std::pair<u64, u64>> files; // hash -> (size, last use)
+	u64 total = 0;
+	for (const CacheEntry& entry : entries) {
+		auto file = files.find(entry.hash);
+		if (file == files.end()) {
+			files[entry.hash] = std::make_pair(entry.size, entry.lastUse);
+			total += entry.size;
+		} else {
+			file->second.second = std::max(file->second.second, entry.lastUse);
+		}
+	}
+	if (total <= cacheBudget) {
+		return;
+	}
+
+	std::vector<std::pair<u64, std::string>> byUse;
+	for (const auto& file : files) {
+		byUse.push_back(std::make_pair(file.second.second, file.first));
+	}
+	std::sort(byUse.begin(), byUse.end());
+
+	std::set<std::string> evicted;
+	for (const auto& file : byUse) {
+		if (total <= cacheBudget || file.first >= keepFrom) {
+			break;
+		}
+		evicted.insert(file.second);
+		total -= files[file.second].first;
+	}
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&evicted](const CacheEntry& entry) {
+		return evicted.count(entry.hash) > 0;
+	}), entries.end());
+}
+
+bool cacheStore(const ReleaseVer& release, const u8* archiveData, const u32 archiveSize, const std::map<std::string, ArchiveBuffer>& payloads) {
+	try {
+		SdWriter writer;
+		writer.createDirectory(PAYLOAD_CACHE_DIR);
+		if (!writer.createDirectory(CACHE_OBJECTS_DIR)) {
+			logPrintf("Could not create %s\n", CACHE_OBJECTS_DIR);
+			return false;
+		}
+
+		std::vector<CacheEntry> entries = cacheLoadIndex();
+		std::set<std::string> stored;
+		for (const CacheEntry& entry : entries) {
+			stored.insert(entry.hash);
+		}
+
+		// Whatever was cached for this release gets replaced
+		const std::string key = cacheReleaseKey(release);
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [&key](const CacheEntry& entry) {
+			return entry.release == key;
+		}), entries.end());
+
+		std::vector<std::pair<std::string, ArchiveBuffer>> files(payloads.begin(), payloads.end());
+		// An archive that doesn't fit would only push everything else out and be evicted itself
+		if (archiveData != nullptr && archiveSize <= cacheBudget) {
+			ArchiveBuffer archive;
+			archive.data = (u8*)archiveData;
+			archive.size = archiveSize;
+			files.push_back(std::make_pair(std::string(CACHE_ARCHIVE_NAME), archive));
+		}
+
+		const u64 now = cacheNextUse(entries);
+		bool ok = true;
+		for (const auto& file : files) {
+			CacheEntry entry{ key, file.first, digestSHA256Hex(file.second.data, file.second.size), file.second.size, now };
+
+			// Same name means same contents, only the size is worth checking
+			SdWriter::ReadHandle handle;
+			u64 size = 0;
+			bool present = writer.openRead(cacheObjectPath(entry.hash), &handle, &size);
+			if (present) {
+				writer.closeRead(handle);
+				present = size == entry.size;
+			}
+			if (!present && !writer.replace(cacheObjectPath(entry.hash), file.second.data, file.second.size)) {
+				logPrintf("Could not cache %s\n", file.first.c_str());
+				ok = false;
+				continue;
+			}
+			entries.push_back(entry);
+		}
+
+		cacheEvict(entries, now);
+
+		// The index goes first: if removing files gets interrupted, they're only wasted space
+		ok = cacheSaveIndex(writer, entries) && ok;
+		for (const CacheEntry& entry : entries) {
+			stored.erase(entry.hash);
+		}
+		for (const std::string& hash : stored) {
+			writer.remove(cacheObjectPath(hash));
+		}
+		return ok;
+	} catch (const std::runtime_error& e) {
+		logPrintf("%s\n", e.what());
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "libs.h"
+
+#include "archive.h"
+#include "release.h"
+
+#define PAYLOAD_CACHE_DIR  "/luma/updater-cache"
+#define CACHE_OBJECTS_DIR  PAYLOAD_CACHE_DIR "/objects"
+#define CACHE_INDEX_PATH   PAYLOAD_CACHE_DIR "/index"
+// Default size budget of the cache (bytes), see "cache size" in the config
+#define CACHE_DEFAULT_SIZE (16 * 1024 * 1024)
+
+/*! \brief Sets how much space the cache may use on SD
+ *  Least recently used files are evicted when a store would go over it.
+ *
+ *  \param bytes Size budget in bytes
+ */
+void cacheSetBudget(const u64 bytes);
+
+/*! \brief Gets a decoded payload from the on-SD cache
+ *
+ * Files are stored by SHA-256 of their contents (under CACHE_OBJECTS_DIR), and an index
+ * maps every release (file name and a hash of its URL) and payload to them. Files are
+ * hashed again when read, anything that doesn't match its name is ignored.
+ *
+ * \param release Release the payload belongs to
+ * \param name    Payload path inside the release archive (eg. DEFAULT_A9LH_PATH)
+ * \param payload Buffer to fill with the payload bytes
+ *
+ * \return true if the payload was found and is intact, false otherwise
+ */
+bool cacheGetPayload(const ReleaseVer& release, const std::string& name, ArchiveBuffer* payload);
+
+/*! \brief Gets a release archive from the on-SD cache
+ *
+ * \param release  Release to look for
+ * \param fileData Output buffer (allocated with malloc, to be freed by the caller)
+ * \param fileSize Output buffer size
+ *
+ * \return true if the archive was found and is intact, false otherwise
+ */
+bool cacheGetArchive(const ReleaseVer& release, u8** fileData, u32* fileSize);
+
+/*! \brief Gets any cached file by its contents
+ *
+ * \param hash SHA-256 of the file (lowercase hex)
+ * \param file Buffer to fill with the file bytes
+ *
+ * \return true if the file is in the cache and intact, false otherwise
+ */
+bool cacheGetObject(const std::string& hash, ArchiveBuffer* file);
+
+/*! \brief Stores a release archive and its decoded payloads in the on-SD cache
+ *
+ * Files already in the cache (same contents) aren't written again. Whatever was indexed
+ * for the release is replaced, then files are evicted until the cache fits its budget.
+ *
+ * \param release     Release the files belong to
+ * \param archiveData Release archive, nullptr to keep only the payloads
+ * \param archiveSize Size of the release archive in bytes
+ * \param payloads    Payloads keyed by their path inside the release archive
+ *
+ * \return true if everything was written, false otherwise
+ */
+bool cacheStore(const ReleaseVer& release, const u8* archiveData, const u32 archiveSize, const std::map<std::string, ArchiveBuffer>& payloads);
\ No newline at end of file
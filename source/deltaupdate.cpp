@@ -0,0 +1,227 @@
+#include "deltaupdate.h"
+
+#include "bytes.h"
+#include "digest.h"
+
+#ifdef _3DS
+#include "cache.h"
+#include "http.h"
+#include "sdwriter.h"
+#include "utils.h"
+#endif
+
+static bool readVarint(const u8*& pos, const u8* end, u64* value) {
+	*value = 0;
+	for (u32 shift = 0; pos < end && shift < 64; shift += 7) {
+		const u8 byte = *pos++;
+		*value |= (u64)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool isSHA256(const std::string& hex) {
+	return hex.length() == 64 && hex.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+std::vector<DeltaEntry> deltaParseManifest(const u8* data, const size_t size) {
+	std::vector<DeltaEntry> entries;
+	std::istringstream manifest(std::string((const char*)data, size));
+	std::string line;
+	while (std::getline(manifest, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream fields(line);
+		DeltaEntry entry;
+		if (!(fields >> entry.release >> entry.payload >> entry.from >> entry.to >> entry.url)) {
+			continue;
+		}
+		std::transform(entry.from.begin(), entry.from.end(), entry.from.begin(), ::tolower);
+		std::transform(entry.to.begin(), entry.to.end(), entry.to.begin(), ::tolower);
+		if (isSHA256(entry.from) && isSHA256(entry.to)) {
+			entries.push_back(entry);
+		}
+	}
+	return entries;
+}
+
+bool deltaApply(const u8* source, const size_t sourceSize, const u8* patch, const size_t patchSize, ArchiveBuffer* target) {
+	if (patchSize < DELTA_HEADER_SIZE || std::memcmp(patch, DELTA_MAGIC, 4) != 0) {
+		return false;
+	}
+	const u32 expectedSourceSize = readU32LE(patch + 4);
+	const u32 targetSize = readU32LE(patch + 8);
+	const u8* sourceHash = patch + 12;
+	const u8* targetHash = patch + 12 + 32;
+
+	u8 sourceResult[32];
+	digestSHA256(source, sourceSize, sourceResult);
+	if (sourceSize != expectedSourceSize || std::memcmp(sourceResult, sourceHash, 32) != 0) {
+		return false;
+	}
+
+	std::shared_ptr<u8> output((u8*)std::malloc(std::max<size_t>(targetSize, 1)), std::free);
+	if (!output) {
+		return false;
+	}
+	u8* out = output.get();
+
+	const u8* pos = patch + DELTA_HEADER_SIZE;
+	const u8* end = patch + patchSize;
+	u64 written = 0;
+	u64 copyEnd = 0;
+	while (pos < end) {
+		u64 header;
+		if (!readVarint(pos, end, &header)) {
+			return false;
+		}
+		const u64 length = header >> 2;
+		if (length > targetSize - written) {
+			return false;
+		}
+
+		switch (header & 3) {
+		case DELTA_OP_ADD:
+			if (length > (u64)(end - pos)) {
+				return false;
+			}
+			std::memcpy(out + written, pos, length);
+			pos += length;
+			break;
+		case DELTA_OP_COPY: {
+			u64 zigzag;
+			if (!readVarint(pos, end, &zigzag)) {
+				return false;
+			}
+			const s64 distance = (s64)(zigzag >> 1) ^ -(s64)(zigzag & 1);
+			const s64 offset = (s64)copyEnd + distance;
+			if (offset < 0 || (u64)offset > sourceSize || length > sourceSize - (u64)offset) {
+				return false;
+			}
+			std::memcpy(out + written, source + offset, length);
+			copyEnd = offset + length;
+			break;
+		}
+		case DELTA_OP_RUN:
+			if (pos >= end) {
+				return false;
+			}
+			std::memset(out + written, *pos++, length);
+			break;
+		default:
+			return false;
+		}
+		written += length;
+	}
+	if (written != targetSize) {
+		return false;
+	}
+
+	u8 targetResult[32];
+	digestSHA256(out, targetSize, targetResult);
+	if (std::memcmp(targetResult, targetHash, 32) != 0) {
+		return false;
+	}
+
+	target->base = output;
+	target->data = out;
+	target->size = targetSize;
+	return true;
+}
+
+#ifdef _3DS
+
+static bool deltaReadFile(const std::string& path, ArchiveBuffer* file) {
+	try {
+		SdWriter writer;
+		u64 size = 0;
+		if (!writer.readFile(path, &file->base, &size)) {
+			return false;
+		}
+		file->data = file->base.get();
+		file->size = size;
+		return true;
+	} catch (const std::runtime_error& e) {
+		logPrintf("%s\n", e.what());
+		return false;
+	}
+}
+
+bool deltaGetPayload(const std::string& manifestURL, const ReleaseVer& release, const std::string& payloadName, const std::string& installedPath, ArchiveBuffer* payload) {
+	u8* manifestData = nullptr;
+	u32 manifestSize = 0;
+	try {
+		httpGet(manifestURL.c_str(), &manifestData, &manifestSize);
+	} catch (const std::runtime_error& e) {
+		logPrintf("Could not get delta manifest: %s\n", e.what());
+		std::free(manifestData);
+		return false;
+	}
+	std::vector<DeltaEntry> entries = deltaParseManifest(manifestData, manifestSize);
+	std::free(manifestData);
+
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&release, &payloadName](const DeltaEntry& entry) {
+		return entry.release != release.filename || entry.payload != payloadName;
+	}), entries.end());
+	if (entries.empty()) {
+		logPrintf("No patches to %s (%s)\n", release.filename.c_str(), payloadName.c_str());
+		return false;
+	}
+
+	// The installed payload is the usual source, payloads of other releases kept in the cache work too
+	ArchiveBuffer source;
+	const DeltaEntry* chosen = nullptr;
+	if (deltaReadFile(installedPath, &source)) {
+		const std::string installedHash = digestSHA256Hex(source.data, source.size);
+		for (const DeltaEntry& entry : entries) {
+			if (entry.from == installedHash) {
+				logPrintf("Found patch from the installed payload\n");
+				chosen = &entry;
+				break;
+			}
+		}
+	}
+	for (const DeltaEntry& entry : entries) {
+		if (chosen != nullptr) {
+			break;
+		}
+		if (cacheGetObject(entry.from, &source)) {
+			logPrintf("Found patch from a cached payload\n");
+			chosen = &entry;
+		}
+	}
+	if (chosen == nullptr) {
+		logPrintf("No patch applies to the installed or cached payloads\n");
+		return false;
+	}
+
+	u8* patchData = nullptr;
+	u32 patchSize = 0;
+	try {
+		logPrintf("Downloading %s\n", chosen->url.c_str());
+		httpGet(chosen->url.c_str(), &patchData, &patchSize, true);
+	} catch (const std::runtime_error& e) {
+		logPrintf("Could not download patch: %s\n", e.what());
+		std::free(patchData);
+		return false;
+	}
+
+	// deltaApply checks the result against the target hash in the patch, which must be the manifest's
+	ArchiveBuffer target;
+	const bool ok = deltaApply(source.data, source.size, patchData, patchSize, &target) &&
+		digestHex(patchData + DELTA_HEADER_SIZE - 32, 32) == chosen->to;
+	std::free(patchData);
+	if (!ok) {
+		logPrintf("Patch didn't apply or gave the wrong payload\n");
+		return false;
+	}
+
+	logPrintf("Patched payload (%u byte patch, %u byte payload)\n", (unsigned)patchSize, (unsigned)target.size);
+	*payload = target;
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "libs.h"
+
+#include "archive.h"
+#include "release.h"
+
+/* Payload patches ("LUD1"), all integers little endian:
+ *
+ *   magic       4 bytes  "LUD1"
+ *   sourceSize  u32
+ *   targetSize  u32
+ *   sourceHash  32 bytes SHA-256 of the payload the patch applies to
+ *   targetHash  32 bytes SHA-256 of the resulting payload
+ *   operations  until the end of the patch
+ *
+ * Every operation starts with a varint (LEB128) holding `length << 2 | type`:
+ *   DELTA_OP_ADD   `length` literal bytes follow
+ *   DELTA_OP_COPY  a signed (zigzag) varint follows, the distance from the end of the
+ *                  previous copy to the source offset to copy `length` bytes from
+ *   DELTA_OP_RUN   one byte follows, repeated `length` times
+ */
+#define DELTA_MAGIC       "LUD1"
+#define DELTA_HEADER_SIZE (4 + 4 + 4 + 32 + 32)
+#define DELTA_OP_ADD      0
+#define DELTA_OP_COPY     1
+#define DELTA_OP_RUN      2
+
+/*! \brief Patch from one payload to another, as listed in a delta manifest */
+struct DeltaEntry {
+	std::string release; //!< Release file name (ReleaseVer::filename)
+	std::string payload; //!< Payload path inside the release (eg. DEFAULT_A9LH_PATH)
+	std::string from;    //!< SHA-256 (hex) of the payload the patch applies to
+	std::string to;      //!< SHA-256 (hex) of the payload it produces
+	std::string url;     //!< Where to download the patch from
+};
+
+/*! \brief Parses a delta manifest
+ *
+ * Manifests are text files with one patch per line:
+ * "<release> <payload> <from sha256> <to sha256> <patch url>". Empty lines and lines
+ * starting with '#' are ignored, so are malformed ones.
+ *
+ * \param data Manifest contents
+ * \param size Size of the manifest in bytes
+ *
+ * \return Every patch listed
+ */
+std::vector<DeltaEntry> deltaParseManifest(const u8* data, const size_t size);
+
+/*! \brief Applies a patch
+ *
+ * The source is checked against the size and hash in the patch header, every operation
+ * is bounds checked, and the result must hash to the target hash.
+ *
+ * \param source     Payload the patch applies to
+ * \param sourceSize Size of the source in bytes
+ * \param patch      Patch contents
+ * \param patchSize  Size of the patch in bytes
+ * \param target     Buffer to fill with the resulting payload
+ *
+ * \return true if the patch applied and the result is verified, false otherwise
+ */
+bool deltaApply(const u8* source, const size_t sourceSize, const u8* patch, const size_t patchSize, ArchiveBuffer* target);
+
+#ifdef _3DS
+/*! \brief Gets a payload by patching one that's already on SD
+ *
+ * The manifest is searched for a patch to the chosen release whose source is either the
+ * installed payload or a payload in the on-SD cache. Callers fall back to downloading the
+ * whole release when this fails.
+ *
+ * \param manifestURL   URL of the delta manifest
+ * \param release       Release to get the payload of
+ * \param payloadName   Payload path inside the release archive (eg. DEFAULT_A9LH_PATH)
+ * \param installedPath Path of the installed payload
+ * \param payload       Buffer to fill with the payload bytes
+ *
+ * \return true if a patch was found, applied and verified, false otherwise
+ */
+bool deltaGetPayload(const std::string& manifestURL, const ReleaseVer& release, const std::string& payloadName, const std::string& installedPath, ArchiveBuffer* payload);
+#endif
\ No newline at end of file
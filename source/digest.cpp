@@ -0,0 +1,356 @@
+#include "digest.h"
+
+// 7z SDK includes
+#include "7z/7zCrc.h"
+
+// SHA-256 (FIPS 180-4)
+
+static const u32 sha256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline u32 rotr(const u32 x, const u32 n) {
+	return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(u32* state, const u8* block) {
+	u32 w[64];
+	for (u32 i = 0; i < 16; i++) {
+		w[i] = ((u32)block[i * 4] << 24) | ((u32)block[i * 4 + 1] << 16) | ((u32)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+	}
+	for (u32 i = 16; i < 64; i++) {
+		const u32 s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const u32 s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	u32 a = state[0], b = state[1], c = state[2], d = state[3];
+	u32 e = state[4], f = state[5], g = state[6], h = state[7];
+	for (u32 i = 0; i < 64; i++) {
+		const u32 t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+		const u32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+Digest::Digest() {
+	md5_init(&md5);
+	crc = CRC_INIT_VAL;
+
+	static const u32 sha256Init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	std::memcpy(sha.state, sha256Init, sizeof(sha256Init));
+	sha.length = 0;
+	sha.used = 0;
+}
+
+void Digest::sha256Update(const u8* data, size_t size) {
+	sha.length += size;
+	if (sha.used > 0) {
+		const u32 take = (u32)std::min<size_t>(64 - sha.used, size);
+		std::memcpy(sha.block + sha.used, data, take);
+		sha.used += take;
+		data += take;
+		size -= take;
+		if (sha.used < 64) {
+			return;
+		}
+		sha256Block(sha.state, sha.block);
+		sha.used = 0;
+	}
+	for (; size >= 64; data += 64, size -= 64) {
+		sha256Block(sha.state, data);
+	}
+	std::memcpy(sha.block, data, size);
+	sha.used = (u32)size;
+}
+
+void Digest::sha256Finish(u8* out) {
+	const u64 bits = sha.length * 8;
+	sha.block[sha.used++] = 0x80;
+	if (sha.used > 56) {
+		std::memset(sha.block + sha.used, 0, 64 - sha.used);
+		sha256Block(sha.state, sha.block);
+		sha.used = 0;
+	}
+	std::memset(sha.block + sha.used, 0, 56 - sha.used);
+	for (u32 i = 0; i < 8; i++) {
+		sha.block[56 + i] = (u8)(bits >> (56 - i * 8));
+	}
+	sha256Block(sha.state, sha.block);
+
+	for (u32 i = 0; i < 8; i++) {
+		out[i * 4]     = (u8)(sha.state[i] >> 24);
+		out[i * 4 + 1] = (u8)(sha.state[i] >> 16);
+		out[i * 4 + 2] = (u8)(sha.state[i] >> 8);
+		out[i * 4 + 3] = (u8)sha.state[i];
+	}
+}
+
+void Digest::trackParts(const ExpectedDigest& expected, const u64 fileSize) {
+	if (expected.type != DigestType::MD5 || expected.parts == 0) {
+		return;
+	}
+	for (const u32 partSize : digestPartSizes(fileSize, expected.parts)) {
+		PartTracker tracker;
+		tracker.partSize = partSize;
+		tracker.filled = 0;
+		tracker.parts = 0;
+		md5_init(&tracker.part);
+		md5_init(&tracker.combined);
+		trackers.push_back(tracker);
+	}
+}
+
+// Completed parts are folded into the combined digest as soon as the stream crosses their end
+void Digest::partsUpdate(PartTracker& tracker, const u8* data, size_t size) {
+	while (size > 0) {
+		const u32 take = (u32)std::min<size_t>(tracker.partSize - tracker.filled, size);
+		md5_append(&tracker.part, (const md5_byte_t *)data, take);
+		tracker.filled += take;
+		data += take;
+		size -= take;
+		if (tracker.filled == tracker.partSize) {
+			md5_byte_t partMD5[16];
+			md5_finish(&tracker.part, partMD5);
+			md5_append(&tracker.combined, partMD5, sizeof(partMD5));
+			md5_init(&tracker.part);
+			tracker.filled = 0;
+			tracker.parts++;
+		}
+	}
+}
+
+void Digest::update(const u8* data, const size_t size) {
+	for (size_t offset = 0; offset < size; offset += DIGEST_SLICE_SIZE) {
+		const size_t length = std::min<size_t>(DIGEST_SLICE_SIZE, size - offset);
+		md5_append(&md5, (const md5_byte_t *)data + offset, length);
+		crc = CrcUpdate(crc, data + offset, length);
+		sha256Update(data + offset, length);
+		for (PartTracker& tracker : trackers) {
+			partsUpdate(tracker, data + offset, length);
+		}
+	}
+}
+
+DigestResult Digest::finish() {
+	DigestResult result;
+	md5_finish(&md5, result.md5);
+	result.crc32 = CRC_GET_DIGEST(crc);
+	sha256Finish(result.sha256);
+
+	for (PartTracker& tracker : trackers) {
+		// The last part is usually shorter
+		if (tracker.filled > 0) {
+			md5_byte_t partMD5[16];
+			md5_finish(&tracker.part, partMD5);
+			md5_append(&tracker.combined, partMD5, sizeof(partMD5));
+			tracker.parts++;
+		}
+		MultipartDigest multipart;
+		multipart.partSize = tracker.partSize;
+		multipart.parts = tracker.parts;
+		md5_finish(&tracker.combined, multipart.md5);
+		result.multipart.push_back(multipart);
+	}
+	return result;
+}
+
+std::vector<u32> digestPartSizes(const u64 fileSize, const u32 parts) {
+	std::vector<u32> sizes;
+	if (parts == 0 || fileSize == 0 || parts > fileSize) {
+		return sizes;
+	}
+
+	// A part size splits the file in `parts` parts if (parts - 1) * size < fileSize <= parts * size
+	const u64 smallest = (fileSize + parts - 1) / parts;
+	const u64 largest = parts > 1 ? (fileSize - 1) / (parts - 1) : UINT32_MAX;
+	auto fits = [smallest, largest](const u64 size) {
+		return size >= smallest && size <= largest && size <= UINT32_MAX;
+	};
+	auto add = [&sizes](const u64 size) {
+		if (sizes.size() < DIGEST_MAX_PART_GUESSES && std::find(sizes.begin(), sizes.end(), (u32)size) == sizes.end()) {
+			sizes.push_back((u32)size);
+		}
+	};
+
+	// aws-cli/boto3, S3 minimum, s3cmd, then other usual picks (MiB)
+	static const u32 commonSizes[] = { 8, 5, 15, 16, 10, 32, 64, 100, 128, 256, 512 };
+	for (const u32 mib : commonSizes) {
+		if (fits((u64)mib << 20)) {
+			add((u64)mib << 20);
+		}
+	}
+	for (u64 size = (smallest + 0xFFFFF) & ~(u64)0xFFFFF; sizes.size() < DIGEST_MAX_PART_GUESSES && fits(size); size += 1 << 20) {
+		add(size);
+	}
+	if (sizes.empty()) {
+		add(parts > 1 ? smallest : fileSize);
+	}
+	return sizes;
+}
+
+static int hexValue(const char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// Decodes exactly `length` bytes of hex, anything else (including leftovers) is an error
+static bool hexDecode(const std::string& hex, const size_t length, std::vector<u8>* out) {
+	if (hex.length() != length * 2) {
+		return false;
+	}
+	out->resize(length);
+	for (size_t i = 0; i < length; i++) {
+		const int high = hexValue(hex[i * 2]);
+		const int low = hexValue(hex[i * 2 + 1]);
+		if (high < 0 || low < 0) {
+			return false;
+		}
+		(*out)[i] = (u8)((high << 4) | low);
+	}
+	return true;
+}
+
+static size_t digestSize(const DigestType type) {
+	switch (type) {
+	case DigestType::MD5:
+		return 16;
+	case DigestType::CRC32:
+		return 4;
+	case DigestType::SHA256:
+		return 32;
+	}
+	return 0;
+}
+
+bool digestParse(const std::string& text, const std::string& source, ExpectedDigest* digest) {
+	std::string value = text;
+
+	// Weak ETags are still a digest of the whole file on S3
+	if (value.compare(0, 2, "W/") == 0) {
+		value = value.substr(2);
+	}
+	if (value.length() >= 2 && value.front() == '"' && value.back() == '"') {
+		value = value.substr(1, value.length() - 2);
+	}
+
+	// "<algorithm>:" first, its name can have a dash in it ("sha-256")
+	DigestType type = DigestType::MD5;
+	const size_t colon = value.find(':');
+	if (colon != std::string::npos) {
+		std::string algorithm = value.substr(0, colon);
+		std::transform(algorithm.begin(), algorithm.end(), algorithm.begin(), ::tolower);
+		if (algorithm == "md5") {
+			type = DigestType::MD5;
+		} else if (algorithm == "crc32") {
+			type = DigestType::CRC32;
+		} else if (algorithm == "sha256" || algorithm == "sha-256") {
+			type = DigestType::SHA256;
+		} else {
+			return false;
+		}
+		value = value.substr(colon + 1);
+	}
+
+	// Multipart S3 ETag, the digest is followed by the part count (plain ETags only)
+	u32 parts = 0;
+	const size_t dash = value.find('-');
+	if (dash != std::string::npos) {
+		if (colon != std::string::npos) {
+			return false;
+		}
+		const std::string count = value.substr(dash + 1);
+		if (count.empty() || count.length() > 5 || count.find_first_not_of("0123456789") != std::string::npos) {
+			return false;
+		}
+		parts = (u32)std::atoi(count.c_str());
+		if (parts == 0) {
+			return false;
+		}
+		value = value.substr(0, dash);
+	}
+
+	if (!hexDecode(value, digestSize(type), &digest->bytes)) {
+		return false;
+	}
+	digest->type = type;
+	digest->parts = parts;
+	digest->source = source;
+	return true;
+}
+
+bool digestMatches(const DigestResult& result, const ExpectedDigest& expected) {
+	switch (expected.type) {
+	case DigestType::MD5:
+		if (expected.bytes.size() != 16) {
+			return false;
+		}
+		if (expected.parts > 0) {
+			for (const MultipartDigest& multipart : result.multipart) {
+				if (multipart.parts == expected.parts && std::memcmp(expected.bytes.data(), multipart.md5, 16) == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+		return std::memcmp(expected.bytes.data(), result.md5, 16) == 0;
+	case DigestType::CRC32: {
+		if (expected.bytes.size() != 4) {
+			return false;
+		}
+		const u32 crc = ((u32)expected.bytes[0] << 24) | ((u32)expected.bytes[1] << 16) | ((u32)expected.bytes[2] << 8) | expected.bytes[3];
+		return crc == result.crc32;
+	}
+	case DigestType::SHA256:
+		return expected.bytes.size() == 32 && std::memcmp(expected.bytes.data(), result.sha256, 32) == 0;
+	}
+	return false;
+}
+
+std::string digestHex(const u8* bytes, const size_t size) {
+	static const char hexdigits[] = "0123456789abcdef";
+	std::string hex(size * 2, '0');
+	for (size_t i = 0; i < size; i++) {
+		hex[i * 2] = hexdigits[bytes[i] >> 4];
+		hex[i * 2 + 1] = hexdigits[bytes[i] & 0xf];
+	}
+	return hex;
+}
+
+void digestSHA256(const u8* data, const size_t size, u8* out) {
+	Digest digest;
+	digest.sha256Update(data, size);
+	digest.sha256Finish(out);
+}
+
+std::string digestSHA256Hex(const u8* data, const size_t size) {
+	u8 hash[32];
+	digestSHA256(data, size, hash);
+	return digestHex(hash, sizeof(hash));
+}
+
+const char* digestName(const DigestType type) {
+	switch (type) {
+	case DigestType::MD5:
+		return "MD5";
+	case DigestType::CRC32:
+		return "CRC32";
+	case DigestType::SHA256:
+		return "SHA-256";
+	}
+	return "";
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "libs.h"
+
+// libmd5-rfc includes
+#include "md5/md5.h"
+
+// Bytes every digest gets fed at a time, so each piece is still cached for the next one
+#define DIGEST_SLICE_SIZE (8 * 1024)
+// Most part sizes tried for a multipart ETag, each one costs an extra MD5 pass
+#define DIGEST_MAX_PART_GUESSES 4
+
+enum class DigestType {
+	MD5,   /*!< 16 bytes, plain S3/CloudFront ETags */
+	CRC32, /*!< 4 bytes, big endian (as written in hex) */
+	SHA256 /*!< 32 bytes, GitHub asset digests */
+};
+
+/*! \brief S3 multipart digest: MD5 of the concatenated MD5s of every part */
+struct MultipartDigest {
+	u32 partSize = 0;
+	u32 parts    = 0;
+	u8  md5[16]  = {};
+};
+
+/*! \brief Digests of a whole file */
+struct DigestResult {
+	u8  md5[16]    = {};
+	u32 crc32      = 0;
+	u8  sha256[32] = {};
+	std::vector<MultipartDigest> multipart; //!< One per part size tracked
+};
+
+/*! \brief A digest a file is expected to have, and where it came from */
+struct ExpectedDigest {
+	DigestType      type = DigestType::MD5;
+	std::vector<u8> bytes;
+	u32             parts = 0; //!< Part count of a multipart S3 ETag, 0 for a digest of the whole file
+	std::string     source;    //!< Shown in logs (eg. "ETag", "release")
+};
+
+/*! \brief Computes MD5, CRC32 and SHA-256 together, one piece of data at a time
+ *
+ * Every piece is split in DIGEST_SLICE_SIZE slices and each slice goes through all three
+ * digests before moving on, so data is only read from memory once.
+ */
+class Digest {
+private:
+	struct SHA256State {
+		u32 state[8];
+		u64 length;
+		u8  block[64];
+		u32 used;
+	};
+
+	struct PartTracker {
+		u32         partSize;
+		u32         filled; //!< Bytes of the current part hashed so far
+		u32         parts;  //!< Parts completed
+		md5_state_t part;
+		md5_state_t combined;
+	};
+
+	md5_state_t md5;
+	u32         crc;
+	SHA256State sha;
+	std::vector<PartTracker> trackers;
+
+	void sha256Update(const u8* data, size_t size);
+	void sha256Finish(u8* out);
+	void partsUpdate(PartTracker& tracker, const u8* data, size_t size);
+
+	friend void digestSHA256(const u8* data, const size_t size, u8* out);
+
+public:
+	Digest();
+
+	/*! \brief Also computes the multipart digests an ETag could have been made with
+	 *
+	 * The part size used for the upload isn't in the ETag, so every plausible one (see
+	 * digestPartSizes) is hashed as the data goes by. Does nothing for whole-file digests.
+	 * Must be called before the first update.
+	 *
+	 * \param expected Expected digest (from digestParse)
+	 * \param fileSize Size of the whole file in bytes
+	 */
+	void trackParts(const ExpectedDigest& expected, const u64 fileSize);
+
+	/*! \brief Feeds the next piece of data to every digest
+	 *
+	 * \param data Data to hash
+	 * \param size Size of the data in bytes
+	 */
+	void update(const u8* data, const size_t size);
+
+	/*! \brief Completes every digest (the object must not be updated afterwards)
+	 *
+	 * \return Digests of everything that was fed
+	 */
+	DigestResult finish();
+};
+
+/*! \brief Guesses the part sizes a multipart upload could have used
+ *
+ * Sizes that split the file in exactly `parts` parts are picked among the defaults of
+ * common S3 clients first, then among whole MiB, then the smallest size that works.
+ *
+ * \param fileSize Size of the whole file in bytes
+ * \param parts    Part count from the ETag
+ *
+ * \return Up to DIGEST_MAX_PART_GUESSES part sizes, most likely first
+ */
+std::vector<u32> digestPartSizes(const u64 fileSize, const u32 parts);
+
+/*! \brief Parses an expected digest
+ *
+ * Accepted forms are "<algorithm>:<hex>" (md5, crc32, sha256, as in GitHub's asset
+ * "digest" field) and MD5 ETags, quoted or weak ("W/"), including multipart S3 ETags
+ * ("<hex>-<parts>").
+ *
+ * \param text   Digest string
+ * \param source Name of where the digest came from, for logs
+ * \param digest Expected digest to fill
+ *
+ * \return true if the string held a digest this can check, false otherwise
+ */
+bool digestParse(const std::string& text, const std::string& source, ExpectedDigest* digest);
+
+/*! \brief Checks computed digests against an expected one
+ *
+ * Multipart ETags match if any of the tracked part sizes gives the same digest.
+ *
+ * \return true if the matching digest is the same, false otherwise
+ */
+bool digestMatches(const DigestResult& result, const ExpectedDigest& expected);
+
+/*! \brief Computes the SHA-256 of a whole buffer (and nothing else, unlike Digest)
+ *
+ * \param data Data to hash
+ * \param size Size of the data in bytes
+ * \param out  32 bytes to write the digest to
+ */
+void digestSHA256(const u8* data, const size_t size, u8* out);
+
+/*! \brief Computes the SHA-256 of a whole buffer, as lowercase hex */
+std::string digestSHA256Hex(const u8* data, const size_t size);
+
+/*! \brief Formats digest bytes as lowercase hex */
+std::string digestHex(const u8* bytes, const size_t size);
+
+/*! \brief Name of a digest type (eg. "SHA-256") */
+const char* digestName(const DigestType type);
\ No newline at end of file
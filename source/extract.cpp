@@ -0,0 +1,197 @@
+#include "extract.h"
+
+#include "pipeline.h"
+#include "sdwriter.h"
+#include "utils.h"
+
+// Files queued between decoder and writer, each one keeps its block alive
+#define EXTRACT_QUEUE_SIZE 4
+#define EXTRACT_STACK_SIZE (32 * 1024)
+
+struct ExtractJob {
+	std::string   path; //!< SD path, empty to stop the writer
+	ArchiveBuffer file;
+};
+
+struct ExtractWriter {
+	StageQueue<ExtractJob, EXTRACT_QUEUE_SIZE> queue;
+	std::unique_ptr<SdWriter> sd;
+	StageStats    stats;
+	u32           files = 0;
+	std::string   error;
+	volatile bool failed = false;
+};
+
+static void writeJob(ExtractWriter& writer, const ExtractJob& job) {
+	const u64 start = svcGetSystemTick();
+	// Files already on SD (config, sysmodules, the updater itself) go through a temp file,
+	// so a failed or interrupted write never leaves them truncated
+	SdWriter& sd = *writer.sd;
+	const bool existed = sd.exists(job.path);
+	if (existed ? !sd.replace(job.path, job.file.data, job.file.size) : !sd.write(job.path, job.file.data, job.file.size)) {
+		writer.error = "Could not write " + job.path + ", ";
+		if (!existed) {
+			writer.error += sd.remove(job.path) ? "the incomplete file was removed" : "an incomplete file was left behind";
+		} else if (sd.exists(job.path)) {
+			writer.error += "the previous version was kept";
+		} else if (sd.exists(job.path + SD_TEMP_SUFFIX)) {
+			writer.error += "the new version was left as " + job.path + SD_TEMP_SUFFIX;
+		} else {
+			writer.error += "the file is missing";
+		}
+		writer.failed = true;
+	}
+	writer.stats.busyTicks += svcGetSystemTick() - start;
+	writer.stats.bytes += job.file.size;
+	writer.files++;
+}
+
+static void writerLoop(ExtractWriter& writer) {
+	while (true) {
+		ExtractJob job = writer.queue.pop(&writer.stats);
+		if (job.path.empty()) {
+			break;
+		}
+		// Keep draining after an error so the decoder never blocks
+		if (!writer.failed) {
+			writeJob(writer, job);
+		}
+	}
+}
+
+// Creates every directory leading to the given paths in one go, parents first
+static bool createDirectories(SdWriter& sd, const std::vector<std::string>& paths, u32* created) {
+	std::set<std::string> dirs;
+	for (const std::string& path : paths) {
+		for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+			dirs.insert(path.substr(0, slash));
+		}
+	}
+
+	// std::set is sorted, so "/a" always comes before "/a/b"
+	for (const std::string& dir : dirs) {
+		bool existed = false;
+		if (!sd.createDirectory(dir, &existed)) {
+			logPrintf("\nCould not create %s\n", dir.c_str());
+			return false;
+		}
+		if (!existed) {
+			(*created)++;
+		}
+	}
+	return true;
+}
+
+// Entry names come from the archive, they must stay below the SD root
+static bool safeRelativePath(const std::string& path) {
+	if (path[0] == '/' || path[0] == '\\' || path.find(':') != std::string::npos) {
+		return false;
+	}
+	size_t start = 0;
+	while (start <= path.length()) {
+		size_t end = path.find_first_of("/\\", start);
+		if (end == std::string::npos) {
+			end = path.length();
+		}
+		if (path.compare(start, end - start, "..") == 0) {
+			return false;
+		}
+		start = end + 1;
+	}
+	return true;
+}
+
+bool extractAll(Archive& archive, const std::string& prefix, const std::vector<std::string>& skip, ExtractStats* stats) {
+	ExtractStats result;
+	const u64 start = svcGetSystemTick();
+
+	// Pick entries and their SD paths, directories get a trailing slash
+	std::vector<std::string> names, paths, dirPaths;
+	for (const ArchiveEntry& entry : archive.entries()) {
+		if (entry.name.compare(0, prefix.length(), prefix) != 0) {
+			continue;
+		}
+		const std::string relative = entry.name.substr(prefix.length());
+		if (relative.empty() || std::find(skip.begin(), skip.end(), relative) != skip.end()) {
+			continue;
+		}
+		if (!safeRelativePath(relative)) {
+			logPrintf("\nFATAL: Refusing to install %s, it points outside of the SD card root\n", entry.name.c_str());
+			return false;
+		}
+		if (entry.isDir) {
+			dirPaths.push_back("/" + relative + (relative.back() == '/' ? "" : "/"));
+		} else {
+			names.push_back(entry.name);
+			paths.push_back("/" + relative);
+			dirPaths.push_back(paths.back());
+		}
+	}
+
+	ExtractWriter writer;
+	writer.stats.name = "write";
+	result.decode.name = "decode";
+	try {
+		writer.sd.reset(new SdWriter());
+	} catch (const std::runtime_error& e) {
+		logPrintf("\n%s (?)\n\n", e.what());
+		return false;
+	}
+
+	if (!createDirectories(*writer.sd, dirPaths, &result.dirs)) {
+		return false;
+	}
+
+	// If the writer thread can't be created, files are written inline instead
+	StageThread writerThread;
+	writerThread.start([&writer]() { writerLoop(writer); }, EXTRACT_STACK_SIZE);
+
+	std::string decodeError;
+	for (size_t i = 0; i < names.size() && !writer.failed; ++i) {
+		const u64 decodeStart = svcGetSystemTick();
+		ExtractJob job;
+		try {
+			job.file = archive.extractFile(names[i]);
+		} catch (const std::runtime_error& e) {
+			decodeError = e.what();
+			break;
+		}
+		result.decode.busyTicks += svcGetSystemTick() - decodeStart;
+		result.decode.bytes += job.file.size;
+		job.path = paths[i];
+
+		if (writerThread.running()) {
+			writer.queue.push(std::move(job), &result.decode);
+		} else {
+			writeJob(writer, job);
+		}
+	}
+
+	if (writerThread.running()) {
+		writer.queue.push(ExtractJob());
+		writerThread.join();
+	}
+
+	result.files = writer.files;
+	result.bytes = writer.stats.bytes;
+	result.write = writer.stats;
+	result.totalTicks = svcGetSystemTick() - start;
+	if (stats != nullptr) {
+		*stats = result;
+	}
+
+	if (!decodeError.empty()) {
+		logPrintf("\nFATAL: %s\n", decodeError.c_str());
+		return false;
+	}
+	if (writer.failed) {
+		logPrintf("\nFATAL: %s\n", writer.error.c_str());
+		return false;
+	}
+	return true;
+}
+
+void extractPrintStats(const ExtractStats& stats) {
+	logPrintf("Extracted %lu files (%llu bytes), created %lu directories\n", stats.files, stats.bytes, stats.dirs);
+	pipelinePrintStats({ stats.decode, stats.write }, stats.totalTicks);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "libs.h"
+
+#include "archive.h"
+#include "pipeline.h"
+
+/*! \brief Timings and totals of a full archive extraction */
+struct ExtractStats {
+	u32        files      = 0; /*!< Files written                        */
+	u32        dirs       = 0; /*!< Directories created                  */
+	u64        bytes      = 0; /*!< Bytes written                        */
+	StageStats decode;         /*!< Decoding stage (calling thread)      */
+	StageStats write;          /*!< Writing stage (writer thread)        */
+	u64        totalTicks = 0; /*!< Wall time of the extraction (ticks)  */
+};
+
+/*! \brief Extracts every file of an archive to the SD card
+ *
+ * Decoding runs on the calling thread while a writer thread saves finished files, the two
+ * are connected by a small bounded queue so decoding never runs too far ahead of the SD.
+ * All directories are created upfront, files are written in large chunks.
+ *
+ * \param archive Archive to extract
+ * \param prefix  Path prefix to strip from entries (eg. "out/"), entries outside it are skipped
+ * \param skip    Entry paths (without prefix) not to write
+ * \param stats   OPTIONAL Pointer to ExtractStats struct to fill with timings
+ *
+ * \return true if every file was written, false otherwise
+ */
+bool extractAll(Archive& archive, const std::string& prefix, const std::vector<std::string>& skip, ExtractStats* stats = nullptr);
+
+/*! \brief Print per-stage busy/idle time and throughput of an extraction
+ *
+ * \param stats Stats filled by extractAll
+ */
+void extractPrintStats(const ExtractStats& stats);
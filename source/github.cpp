@@ -0,0 +1,57 @@
+#include "github.h"
+
+// Same order as the paths given to the stream
+enum GitHubPath {
+	GitHubTagName,
+	GitHubName,
+	GitHubBody,
+	GitHubAssetEnd,
+	GitHubAssetName,
+	GitHubAssetURL,
+	GitHubAssetSize,
+	GitHubAssetDigest
+};
+
+GitHubReleaseReader::GitHubReleaseReader(GitHubRelease* release)
+	: release(release),
+	  stream({ "tag_name", "name", "body", "assets[]", "assets[].name", "assets[].browser_download_url", "assets[].size", "assets[].digest" },
+		[this](const size_t path, const JsonType type, const std::string& value) { onValue(path, type, value); }) {}
+
+void GitHubReleaseReader::onValue(const size_t path, const JsonType type, const std::string& value) {
+	switch (path) {
+	case GitHubTagName:
+		release->tagName = value;
+		break;
+	case GitHubName:
+		release->name = value;
+		break;
+	case GitHubBody:
+		release->body = value;
+		break;
+	case GitHubAssetName:
+		current.name = value;
+		hasName = true;
+		break;
+	case GitHubAssetURL:
+		current.url = value;
+		hasURL = true;
+		break;
+	case GitHubAssetSize:
+		current.size = std::strtoull(value.c_str(), nullptr, 10);
+		hasSize = true;
+		break;
+	case GitHubAssetDigest:
+		// Only newer assets have one, older ones have null
+		if (type == JsonType::String) {
+			current.digest = value;
+		}
+		break;
+	case GitHubAssetEnd:
+		if (hasName && hasURL && hasSize) {
+			release->assets.push_back(current);
+		}
+		current = GitHubAsset();
+		hasName = hasURL = hasSize = false;
+		break;
+	}
+}
\ No newline at end of file
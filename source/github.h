@@ -0,0 +1,55 @@
+#pragma once
+
+#include "libs.h"
+
+#include "jsonstream.h"
+
+/*! \brief Asset of a GitHub release */
+struct GitHubAsset {
+	std::string name;     //!< File name
+	std::string url;      //!< browser_download_url
+	u64         size = 0; //!< Size in bytes
+	std::string digest;   //!< "sha256:<hex>", empty on older assets
+};
+
+/*! \brief The parts of a GitHub API release (repos/.../releases/latest) the updater uses */
+struct GitHubRelease {
+	std::string tagName;
+	std::string name;
+	std::string body;
+	std::vector<GitHubAsset> assets; //!< Only assets with a name, URL and size
+};
+
+/*! \brief Reads a GitHub API release as it's downloaded (see JsonStream)
+ *
+ * Fields are selected by their full path, so the release "name" can't be mixed up with
+ * the name of an asset or its uploader, whatever other fields GitHub adds.
+ */
+class GitHubReleaseReader {
+private:
+	GitHubRelease* release;
+	JsonStream     stream;
+	GitHubAsset    current;
+	bool           hasName = false, hasURL = false, hasSize = false;
+
+	void onValue(const size_t path, const JsonType type, const std::string& value);
+
+public:
+	/*! \brief Creates a reader
+	 *
+	 * \param release Release to fill
+	 */
+	GitHubReleaseReader(GitHubRelease* release);
+
+	/*! \brief Reads the next piece of the reply
+	 *
+	 * \return false if the reply isn't valid JSON
+	 */
+	bool feed(const u8* data, const size_t size) { return stream.feed(data, size); }
+
+	/*! \brief Ends the reply
+	 *
+	 * \return true if the whole reply was valid JSON
+	 */
+	bool finish() { return stream.finish(); }
+};
\ No newline at end of file
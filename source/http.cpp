@@ -5,14 +5,16 @@
 #include "certs/cybertrust.h"
 #include "certs/digicert.h"
 
-// libmd5-rfc includes
-#include "md5/md5.h"
-
-void httpGet(const char* url, u8** buf, u32* size, const bool verbose, HTTPResponseInfo* info) {
+// Buf is nullptr to stream the body to receive instead of keeping it (see httpGetStream)
+// Range is a "Range" header value ("bytes=<first>-<last>"), or nullptr for the whole file
+static void httpRequest(const char* url, const char* range, u8** buf, u32* size, const bool verbose, HTTPResponseInfo* info, const HTTPReceiveFunc& receive) {
 	httpcContext context;
 	CHECK(httpcOpenContext(&context, HTTPC_METHOD_GET, (char*)url, 0), "Could not open HTTP context");
 	// Add User Agent field (required by Github API calls)
 	CHECK(httpcAddRequestHeaderField(&context, (char*)"User-Agent", (char*)"LUMA-UPDATER"), "Could not set User Agent");
+	if (range != nullptr) {
+		CHECK(httpcAddRequestHeaderField(&context, (char*)"Range", (char*)range), "Could not set Range");
+	}
 
 	// Add root CA required for Github and AWS URLs
 	CHECK(httpcAddTrustedRootCA(&context, cybertrust_cer, cybertrust_cer_len), "Could not add Cybertrust root CA");
@@ -22,16 +24,18 @@ void httpGet(const char* url, u8** buf, u32* size, const bool verbose, HTTPRespo
 
 	u32 statuscode = 0;
 	CHECK(httpcGetResponseStatusCode(&context, &statuscode), "Could not get status code");
-	if (statuscode != 200) {
+	// A server that ignores Range answers 200 with the whole file, which is not what was asked for
+	const u32 expectedStatus = range != nullptr ? 206 : 200;
+	if (statuscode != expectedStatus) {
 		// Handle 3xx codes
 		if (statuscode >= 300 && statuscode < 400) {
 			char newUrl[1024];
 			CHECK(httpcGetResponseHeader(&context, (char*)"Location", newUrl, 1024), "Could not get Location header for 3xx reply");
 			CHECK(httpcCloseContext(&context), "Could not close HTTP context");
-			httpGet(newUrl, buf, size, verbose, info);
+			httpRequest(newUrl, range, buf, size, verbose, info, receive);
 			return;
 		}
-		throw std::runtime_error(formatErrMessage("Non-200 status code", statuscode));
+		throw std::runtime_error(formatErrMessage(range != nullptr ? "Non-206 status code" : "Non-200 status code", statuscode));
 	}
 
 	// Retrieve extra info if required
@@ -49,19 +53,45 @@ void httpGet(const char* url, u8** buf, u32* size, const bool verbose, HTTPRespo
 
 	CHECK(httpcGetDownloadSizeState(&context, &dlstartpos, size), "Could not get file size");
 
-	*buf = (u8*)std::malloc(*size);
-	if (*buf == NULL) throw std::runtime_error(formatErrMessage("Could not allocate enough memory", *size));
-	std::memset(*buf, 0, *size);
-
-	while (pos < *size && dlret == (s32)HTTPC_RESULTCODE_DOWNLOADPENDING)
-	{
-		u32 sz = *size - pos;
-		dlret = httpcReceiveData(&context, *buf + pos, sz);
-		CHECK(httpcGetDownloadSizeState(&context, &dlpos, NULL), "Could not get file size");
-		pos = dlpos - dlstartpos;
-		if (verbose) {
-			logPrintf("Download progress: %lu / %lu", dlpos, *size);
-			gfxFlushBuffers();
+	// Streaming: pieces go through one small buffer, nothing grows with the reply
+	if (buf == nullptr) {
+		const u32 total = *size;
+		std::vector<u8> chunk(HTTP_CHUNK_SIZE);
+		while (dlret == (s32)HTTPC_RESULTCODE_DOWNLOADPENDING) {
+			dlret = httpcReceiveData(&context, chunk.data(), chunk.size());
+			if (dlret != 0 && dlret != (s32)HTTPC_RESULTCODE_DOWNLOADPENDING) {
+				httpcCloseContext(&context);
+				throw std::runtime_error(formatErrMessage("Could not receive data", dlret));
+			}
+			CHECK(httpcGetDownloadSizeState(&context, &dlpos, NULL), "Could not get file size");
+			if (dlpos - dlstartpos > pos) {
+				receive(chunk.data(), dlpos - dlstartpos - pos);
+			}
+			pos = dlpos - dlstartpos;
+			if (verbose) {
+				logPrintf("Download progress: %lu / %lu", pos, total);
+				gfxFlushBuffers();
+			}
+		}
+		*size = pos;
+	} else {
+		*buf = (u8*)std::malloc(*size);
+		if (*buf == NULL) throw std::runtime_error(formatErrMessage("Could not allocate enough memory", *size));
+		std::memset(*buf, 0, *size);
+
+		while (pos < *size && dlret == (s32)HTTPC_RESULTCODE_DOWNLOADPENDING)
+		{
+			u32 sz = *size - pos;
+			dlret = httpcReceiveData(&context, *buf + pos, sz);
+			CHECK(httpcGetDownloadSizeState(&context, &dlpos, NULL), "Could not get file size");
+			if (receive && dlpos - dlstartpos > pos) {
+				receive(*buf + pos, dlpos - dlstartpos - pos);
+			}
+			pos = dlpos - dlstartpos;
+			if (verbose) {
+				logPrintf("Download progress: %lu / %lu", dlpos, *size);
+				gfxFlushBuffers();
+			}
 		}
 	}
 	
@@ -72,26 +102,36 @@ void httpGet(const char* url, u8** buf, u32* size, const bool verbose, HTTPRespo
 	CHECK(httpcCloseContext(&context), "Could not close HTTP context");
 }
 
+void httpGet(const char* url, u8** buf, u32* size, const bool verbose, HTTPResponseInfo* info, const HTTPReceiveFunc& receive) {
+	httpRequest(url, nullptr, buf, size, verbose, info, receive);
+}
 
-bool httpCheckETag(std::string etag, const u8* fileData, const u32 fileSize) {
-	// Strip quotes from either side of the etag
-	if (etag[0] == '"') {
-		etag = etag.substr(1, etag.length() - 2);
+void httpGetStream(const char* url, const HTTPReceiveFunc& receive, u32* size, const bool verbose) {
+	u32 received = 0;
+	httpRequest(url, nullptr, nullptr, &received, verbose, nullptr, receive);
+	if (size != nullptr) {
+		*size = received;
 	}
+}
 
-	// Get MD5 bytes from Etag header
-	md5_byte_t expected[16];
-	const char* etagchr = etag.c_str();
-	for (u8 i = 0; i < 16; i++) {
-		std::sscanf(etagchr + (i * 2), "%02x", &expected[i]);
+void httpGetRange(const char* url, const u32 offset, const u32 length, u8* out) {
+	char range[32];
+	std::snprintf(range, sizeof(range), "bytes=%lu-%lu", (unsigned long)offset, (unsigned long)(offset + length - 1));
+
+	u8* data = nullptr;
+	u32 size = 0;
+	try {
+		httpRequest(url, range, &data, &size, false, nullptr, nullptr);
+	} catch (const std::runtime_error&) {
+		std::free(data);
+		throw;
 	}
-
-	// Calculate MD5 hash of downloaded archive
-	md5_state_t state;
-	md5_byte_t result[16];
-	md5_init(&state);
-	md5_append(&state, (const md5_byte_t *)fileData, fileSize);
-	md5_finish(&state, result);
-
-	return memcmp(expected, result, 16) == 0;
-}
+	const bool complete = size == length;
+	if (complete) {
+		std::memcpy(out, data, length);
+	}
+	std::free(data);
+	if (!complete) {
+		throw std::runtime_error(formatErrMessage("Wrong range size", size));
+	}
+}
\ No newline at end of file
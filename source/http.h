@@ -7,6 +7,15 @@ struct HTTPResponseInfo {
 	std::string etag; //!< ETag (for AWS S3 requests)
 };
 
+// Buffer pieces are received into by httpGetStream
+#define HTTP_CHUNK_SIZE (8 * 1024)
+
+/*! \brief Called with every piece of the body as soon as it's received
+ *  With httpGet the pointer stays valid after the call (it points into the output buffer),
+ *  with httpGetStream it is only valid during the call.
+ */
+typedef std::function<void(const u8* data, const u32 size)> HTTPReceiveFunc;
+
 /*! \brief Makes a GET HTTP request
  *  This function will throw an exception if it encounters any error
  *
@@ -15,15 +24,29 @@ struct HTTPResponseInfo {
  *  \param size    Output buffer size
  *  \param verbose OPTIONAL Write download progress to screen (via printf)
  *  \param info    OPTIONAL Pointer to HTTPResponseInfo struct to fill with extra data
+ *  \param receive OPTIONAL Function to hand received data to while the download goes on
  */
-void httpGet(const char* url, u8** buf, u32* size, const bool verbose = false, HTTPResponseInfo* info = nullptr);
+void httpGet(const char* url, u8** buf, u32* size, const bool verbose = false, HTTPResponseInfo* info = nullptr, const HTTPReceiveFunc& receive = nullptr);
 
-/*! \brief Check for file integrity via ETag (MD5)
+/*! \brief Makes a GET HTTP request without keeping the reply
+ *  The body is received in pieces of at most HTTP_CHUNK_SIZE bytes, each handed to `receive`
+ *  and then dropped, so memory use doesn't depend on the size of the reply.
+ *  This function will throw an exception if it encounters any error
  *
- *  \param etag     ETag header string
- *  \param fileData Pointer to file data to check
- *  \param fileSize Size of the file to check
+ *  \param url     URL to download
+ *  \param receive Function to hand received data to
+ *  \param size    OPTIONAL Bytes received
+ *  \param verbose OPTIONAL Write download progress to screen (via printf)
+ */
+void httpGetStream(const char* url, const HTTPReceiveFunc& receive, u32* size = nullptr, const bool verbose = false);
+
+/*! \brief Downloads part of a file with a Range request
+ *  This function will throw an exception if it encounters any error, including servers
+ *  that don't support ranges.
  *
- *  \return true if the check succeeds (md5 match), false otherwise
+ *  \param url    URL to download from
+ *  \param offset Offset of the first byte to get
+ *  \param length Bytes to get (must be at least 1)
+ *  \param out    Buffer to write them to, at least `length` bytes
  */
-bool httpCheckETag(std::string etag, const u8* fileData, const u32 fileSize);
\ No newline at end of file
+void httpGetRange(const char* url, const u32 offset, const u32 length, u8* out);
\ No newline at end of file
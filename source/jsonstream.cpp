@@ -0,0 +1,394 @@
+#include "jsonstream.h"
+
+static bool isSpace(const char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hexValue(const char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// FNV-1a, seeded so a seed without collisions can be searched for
+static u32 hashStart(const u32 seed) {
+	return 2166136261u ^ seed;
+}
+
+static u32 hashStep(const u32 hash, const char c) {
+	return (hash ^ (u8)c) * 16777619u;
+}
+
+static u32 hashSlot(u32 hash, const size_t slots) {
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6d;
+	hash ^= hash >> 12;
+	return hash & (slots - 1);
+}
+
+static u32 hashKey(const std::string& key, const u32 seed, const size_t slots) {
+	u32 hash = hashStart(seed);
+	for (const char c : key) {
+		hash = hashStep(hash, c);
+	}
+	return hashSlot(hash, slots);
+}
+
+JsonStream::JsonStream(const std::vector<std::string>& paths, const JsonValueFunc& onValue)
+	: onValue(onValue) {
+	compile(paths);
+}
+
+void JsonStream::compile(const std::vector<std::string>& paths) {
+	nodes.assign(1, Node());
+	for (size_t i = 0; i < paths.size(); i++) {
+		int current = 0;
+		const std::string& path = paths[i];
+		for (size_t pos = 0; pos < path.length();) {
+			if (path.compare(pos, 2, "[]") == 0) {
+				if (nodes[current].element < 0) {
+					nodes[current].element = nodes.size();
+					nodes.push_back(Node());
+				}
+				current = nodes[current].element;
+				pos += 2;
+				continue;
+			}
+			if (path[pos] == '.') {
+				pos++;
+				continue;
+			}
+
+			const size_t end = std::min(path.find('.', pos), path.find("[]", pos));
+			const std::string segment = path.substr(pos, end - pos);
+			pos = std::min(end, path.length());
+
+			const u32 id = std::find(keys.begin(), keys.end(), segment) - keys.begin();
+			if (id == keys.size()) {
+				keys.push_back(segment);
+				keyMax = std::max(keyMax, segment.length());
+			}
+			auto next = std::find_if(nodes[current].children.begin(), nodes[current].children.end(), [id](const std::pair<u32, u32>& child) {
+				return child.first == id;
+			});
+			if (next != nodes[current].children.end()) {
+				current = next->second;
+			} else {
+				nodes[current].children.push_back(std::make_pair(id, (u32)nodes.size()));
+				current = nodes.size();
+				nodes.push_back(Node());
+			}
+		}
+		if (nodes[current].match < 0) {
+			nodes[current].match = i;
+		}
+	}
+
+	// A handful of keys, any table twice their count finds a seed without collisions quickly
+	size_t slots = 1;
+	while (slots < keys.size() * 2) {
+		slots <<= 1;
+	}
+	for (keySeed = 0;; keySeed++) {
+		if (keySeed == 1024) {
+			slots <<= 1;
+			keySeed = 0;
+		}
+		keySlots.assign(slots, -1);
+		bool collision = false;
+		for (size_t id = 0; id < keys.size() && !collision; id++) {
+			int& slot = keySlots[hashKey(keys[id], keySeed, slots)];
+			collision = slot >= 0;
+			slot = id;
+		}
+		if (!collision) {
+			break;
+		}
+	}
+}
+
+// Node of the key just read in the current object
+int JsonStream::child(const int parent) const {
+	if (parent < 0 || !keyUseful) {
+		return -1;
+	}
+	const int id = keySlots[hashSlot(keyHash, keySlots.size())];
+	if (id < 0 || keys[id] != key) {
+		return -1;
+	}
+	for (const auto& next : nodes[parent].children) {
+		if (next.first == (u32)id) {
+			return next.second;
+		}
+	}
+	return -1;
+}
+
+// Keys longer than every key of the paths can't match, they're not kept
+void JsonStream::appendKey(const char c) {
+	if (!keyUseful) {
+		return;
+	}
+	if (key.length() == keyMax) {
+		keyUseful = false;
+		return;
+	}
+	key += c;
+	keyHash = hashStep(keyHash, c);
+}
+
+void JsonStream::beginValue() {
+	opened = false;
+	match = node >= 0 ? nodes[node].match : -1;
+	value.clear();
+}
+
+// A value is complete, wait for what comes after it
+void JsonStream::endValue() {
+	opened = false;
+	match = -1;
+	value.clear();
+	state = stack.empty() ? State::Done : State::AfterValue;
+}
+
+void JsonStream::appendCodepoint(u32 codepoint) {
+	if (!inKey && match < 0) {
+		return;
+	}
+	char bytes[4];
+	size_t length = 0;
+	if (codepoint < 0x80) {
+		bytes[length++] = (char)codepoint;
+	} else if (codepoint < 0x800) {
+		bytes[length++] = (char)(0xC0 | (codepoint >> 6));
+		bytes[length++] = (char)(0x80 | (codepoint & 0x3F));
+	} else if (codepoint < 0x10000) {
+		bytes[length++] = (char)(0xE0 | (codepoint >> 12));
+		bytes[length++] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		bytes[length++] = (char)(0x80 | (codepoint & 0x3F));
+	} else {
+		bytes[length++] = (char)(0xF0 | (codepoint >> 18));
+		bytes[length++] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+		bytes[length++] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		bytes[length++] = (char)(0x80 | (codepoint & 0x3F));
+	}
+	for (size_t i = 0; i < length; i++) {
+		if (inKey) {
+			appendKey(bytes[i]);
+		} else {
+			value += bytes[i];
+		}
+	}
+}
+
+bool JsonStream::step(const char c) {
+	switch (state) {
+	case State::Value:
+		if (isSpace(c)) {
+			return true;
+		}
+		if (c == '{' || c == '[') {
+			if (stack.size() >= JSONSTREAM_MAX_DEPTH) {
+				break;
+			}
+			stack.push_back(Frame{ c == '{', node });
+			if (c == '[') {
+				node = node >= 0 ? nodes[node].element : -1;
+			}
+			state = c == '{' ? State::ObjectKey : State::Value;
+			opened = true;
+			return true;
+		}
+		// Only an empty container can end where a value or key is expected
+		if (c == ']' && opened) {
+			state = State::AfterValue;
+			return step(c);
+		}
+		if (c == '"') {
+			beginValue();
+			inKey = false;
+			highSurrogate = 0;
+			state = State::String;
+			return true;
+		}
+		if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+			beginValue();
+			if (match >= 0) {
+				value += c;
+			}
+			state = State::Primitive;
+			return true;
+		}
+		break;
+
+	case State::ObjectKey:
+		if (isSpace(c)) {
+			return true;
+		}
+		if (c == '"') {
+			key.clear();
+			keyHash = hashStart(keySeed);
+			keyUseful = stack.back().node >= 0 && !nodes[stack.back().node].children.empty();
+			inKey = true;
+			opened = false;
+			highSurrogate = 0;
+			state = State::String;
+			return true;
+		}
+		if (c == '}' && opened) {
+			state = State::AfterValue;
+			return step(c);
+		}
+		break;
+
+	case State::Colon:
+		if (isSpace(c)) {
+			return true;
+		}
+		if (c == ':') {
+			node = child(stack.back().node);
+			state = State::Value;
+			return true;
+		}
+		break;
+
+	case State::AfterValue:
+		if (isSpace(c)) {
+			return true;
+		}
+		if (c == ',') {
+			if (stack.back().isObject) {
+				state = State::ObjectKey;
+			} else {
+				node = stack.back().node >= 0 ? nodes[stack.back().node].element : -1;
+				state = State::Value;
+			}
+			return true;
+		}
+		if ((c == '}' && stack.back().isObject) || (c == ']' && !stack.back().isObject)) {
+			const Frame frame = stack.back();
+			stack.pop_back();
+			if (frame.node >= 0 && nodes[frame.node].match >= 0) {
+				onValue(nodes[frame.node].match, frame.isObject ? JsonType::Object : JsonType::Array, "");
+			}
+			endValue();
+			return true;
+		}
+		break;
+
+	case State::String:
+		if (c == '"') {
+			if (inKey) {
+				inKey = false;
+				state = State::Colon;
+				return true;
+			}
+			if (match >= 0) {
+				onValue(match, JsonType::String, value);
+			}
+			endValue();
+			return true;
+		}
+		if (c == '\\') {
+			state = State::Escape;
+			return true;
+		}
+		if (highSurrogate != 0) {
+			appendCodepoint(0xFFFD);
+			highSurrogate = 0;
+		}
+		if (inKey) {
+			appendKey(c);
+		} else if (match >= 0) {
+			value += c;
+		}
+		return true;
+
+	case State::Escape: {
+		static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+		state = State::String;
+		if (c == 'u') {
+			unicode = 0;
+			unicodeDigits = 0;
+			state = State::Unicode;
+			return true;
+		}
+		for (const char* escape = escapes; *escape != '\0'; escape += 2) {
+			if (*escape == c) {
+				appendCodepoint((u8)escape[1]);
+				return true;
+			}
+		}
+		break;
+	}
+
+	case State::Unicode: {
+		const int digit = hexValue(c);
+		if (digit < 0) {
+			break;
+		}
+		unicode = unicode << 4 | digit;
+		if (++unicodeDigits < 4) {
+			return true;
+		}
+		state = State::String;
+		// Characters past U+FFFF come as two escapes (UTF-16 surrogates)
+		if (unicode >= 0xD800 && unicode < 0xDC00) {
+			highSurrogate = unicode;
+		} else if (unicode >= 0xDC00 && unicode < 0xE000) {
+			appendCodepoint(highSurrogate != 0 ? 0x10000 + ((highSurrogate - 0xD800) << 10) + (unicode - 0xDC00) : 0xFFFD);
+			highSurrogate = 0;
+		} else {
+			appendCodepoint(highSurrogate != 0 ? 0xFFFD : unicode);
+			if (highSurrogate != 0) {
+				appendCodepoint(unicode);
+			}
+			highSurrogate = 0;
+		}
+		return true;
+	}
+
+	case State::Primitive:
+		if (std::isalnum((unsigned char)c) || c == '.' || c == '+' || c == '-') {
+			if (match >= 0) {
+				value += c;
+			}
+			return true;
+		}
+		if (match >= 0) {
+			onValue(match, JsonType::Primitive, value);
+		}
+		endValue();
+		return step(c);
+
+	case State::Done:
+		if (isSpace(c)) {
+			return true;
+		}
+		break;
+
+	case State::Error:
+		return false;
+	}
+
+	state = State::Error;
+	return false;
+}
+
+bool JsonStream::feed(const u8* data, const size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		if (!step((char)data[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool JsonStream::finish() {
+	// A top-level number only ends with the document
+	if (state == State::Primitive) {
+		step(' ');
+	}
+	return state == State::Done;
+}
\ No newline at end of file
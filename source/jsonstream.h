@@ -0,0 +1,113 @@
+#pragma once
+
+#include "libs.h"
+
+// Deepest nesting accepted, deeper documents are rejected rather than growing the stack
+#define JSONSTREAM_MAX_DEPTH 32
+
+enum class JsonType {
+	Object,   /*!< Reported when it closes, with an empty value */
+	Array,    /*!< Reported when it closes, with an empty value */
+	String,   /*!< Value is unescaped (UTF-8)                   */
+	Primitive /*!< Number, true, false or null, as written      */
+};
+
+/*! \brief Called with every value whose path was asked for
+ *
+ * \param path  Index of the path in the list given to JsonStream
+ * \param type  Type of the value
+ * \param value Value (see JsonType)
+ */
+typedef std::function<void(const size_t path, const JsonType type, const std::string& value)> JsonValueFunc;
+
+/*! \brief Push-style JSON reader that only keeps the values it's asked for
+ *
+ * Data is fed in pieces of any size (eg. as they are downloaded), there is no token array
+ * and nothing is kept but the current path and the value being read, so memory doesn't
+ * grow with the document.
+ *
+ * Paths are object keys joined with '.', with "[]" for array elements: "name" is a key
+ * of the top-level object, "assets[].size" the "size" key of every object in its "assets"
+ * array, "assets[]" each of those objects (reported once it's complete).
+ *
+ * Paths are compiled into a tree when the reader is created, and every container being
+ * read knows its node in it: a key is looked up among the keys of the paths with a
+ * perfect hash computed as it's read, then followed to its child node. Anything outside
+ * of the tree is skipped without looking at its keys.
+ */
+class JsonStream {
+private:
+	enum class State {
+		Value,       //!< Expecting a value
+		ObjectKey,   //!< Expecting a key (or the end of the object)
+		Colon,       //!< Expecting ':' after a key
+		AfterValue,  //!< Expecting ',' or the end of the container
+		String,      //!< Inside a string
+		Escape,      //!< After a '\' in a string
+		Unicode,     //!< Inside a \uXXXX escape
+		Primitive,   //!< Inside a number, true, false or null
+		Done,        //!< Top-level value read, only whitespace may follow
+		Error        //!< Malformed, everything else is ignored
+	};
+
+	//! Path tree node, one per distinct path prefix
+	struct Node {
+		int match   = -1; //!< Index of the path ending here, -1 if none
+		int element = -1; //!< Node of the array elements ("[]"), -1 if none
+		std::vector<std::pair<u32, u32>> children; //!< (key id, node) of every key
+	};
+
+	struct Frame {
+		bool isObject;
+		int  node; //!< Node of the container, -1 if outside of the tree
+	};
+
+	std::vector<Node>        nodes;
+	std::vector<std::string> keys;     //!< Every key of the paths, by id
+	std::vector<int>         keySlots; //!< Perfect hash table: key id of every slot, -1 if empty
+	u32                      keySeed = 0;
+	size_t                   keyMax  = 0; //!< Longest key of the paths
+	JsonValueFunc            onValue;
+
+	State              state         = State::Value;
+	std::vector<Frame> stack;
+	int                node          = 0;     //!< Node of the value being read, -1 if outside of the tree
+	std::string        key;
+	u32                keyHash       = 0;     //!< Hash of the key read so far
+	bool               keyUseful     = false; //!< The key being read could be in the tree
+	bool               inKey         = false; //!< The string being read is a key
+	bool               opened        = false; //!< Nothing read since the last '[' or '{'
+	int                match         = -1;    //!< Path index of the value being read
+	std::string        value;
+	u32                unicode       = 0;     //!< \uXXXX being read
+	u32                unicodeDigits = 0;
+	u32                highSurrogate = 0;     //!< First half of a UTF-16 pair, 0 if none
+
+	void compile(const std::vector<std::string>& paths);
+	int  child(const int parent) const;
+	void appendKey(const char c);
+	void beginValue();
+	void endValue();
+	void appendCodepoint(u32 codepoint);
+	bool step(const char c);
+
+public:
+	/*! \brief Creates a reader
+	 *
+	 * \param paths   Paths of the values to report (see above)
+	 * \param onValue Function called with every value found at one of the paths
+	 */
+	JsonStream(const std::vector<std::string>& paths, const JsonValueFunc& onValue);
+
+	/*! \brief Reads the next piece of the document
+	 *
+	 * \return false if the document is malformed (then every later piece is ignored)
+	 */
+	bool feed(const u8* data, const size_t size);
+
+	/*! \brief Ends the document
+	 *
+	 * \return true if a whole, well formed document was read
+	 */
+	bool finish();
+};
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <fstream>
 #include <functional>
 #include <map>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -17,7 +19,21 @@
 #include <cstring>
 
 // CTRULIB includes
+#ifdef _3DS
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
 #include <3ds.h>
-#pragma GCC diagnostic pop
\ No newline at end of file
+#pragma GCC diagnostic pop
+#else
+// Host builds (tools/) only need ctrulib's integer types
+#include <cstdint>
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef s32      Result;
+#endif
\ No newline at end of file
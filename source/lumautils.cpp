@@ -1,5 +1,6 @@
 #include "lumautils.h"
 
+#include "unicode.h"
 #include "utils.h"
 
 static const std::string PayloadPath = "/luma/payloads/";
@@ -30,13 +31,7 @@ std::vector<std::string> listPayloads() {
 			break;
 		}
 
-		// Convert name to ASCII (just cut the other bytes) and compare with prefix
-		char name8[262] = { 0 };
-		for (size_t i = 0; i < 262; i++) {
-			name8[i] = entry.name[i] % 0xff;
-		}
-
-		files.push_back(std::string(name8));
+		files.push_back(utf16ToUtf8(entry.name, utf16Length(entry.name, 262)));
 	}
 
 	FSUSER_CloseArchive(sdmcArchive);
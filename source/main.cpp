@@ -2,6 +2,7 @@
 
 #include "arnutil.h"
 #include "autoupdate.h"
+#include "cache.h"
 #include "config.h"
 #include "console.h"
 #include "update.h"
@@ -54,6 +55,7 @@ struct UpdateInfo {
 	LumaVersion  backupVersion;
 	bool         migrateARN     = false;
 	bool         backupExists   = false;
+	bool         backupDetected = false;
 
 	// Configuration options
 	PayloadType  payloadType    = PayloadType::A9LH;
@@ -61,6 +63,12 @@ struct UpdateInfo {
 	bool         backupExisting = true;
 	bool         selfUpdate     = true;
 	bool         writeLog       = true;
+	bool         cachePayloads  = false;
+	bool         installAll     = false;
+	bool         verifyWrite    = true;
+	std::string  deltaManifest  = "";
+	std::string  syncMirror     = "";
+	std::string  stableManifest = "";
 
 	// Available data
 	ReleaseInfo* stable = nullptr;
@@ -70,7 +78,7 @@ struct UpdateInfo {
 	UpdateChoice choice = UpdateChoice(ChoiceType::NoChoice);
 
 	UpdateArgs getArgs() {
-		return UpdateArgs{ payloadType, payloadPath, backupExisting, migrateARN, choice.chosenVersion, choice.isHourly };
+		return UpdateArgs{ payloadType, payloadPath, backupExisting, migrateARN, choice.chosenVersion, choice.isHourly, cachePayloads, installAll, verifyWrite, deltaManifest, syncMirror };
 	}
 };
 
@@ -523,6 +531,13 @@ int main(int argc, char* argv[]) {
 	updateInfo.backupExisting = tolower(config.Get("backup", "y")[0]) == 'y';
 	updateInfo.selfUpdate = tolower(config.Get("selfupdate", "y")[0]) == 'y';
 	updateInfo.writeLog = tolower(config.Get("log enable", "y")[0]) == 'y';
+	updateInfo.cachePayloads = tolower(config.Get("payload cache", "n")[0]) == 'y';
+	cacheSetBudget((u64)std::max(std::atoi(config.Get("cache size", tostr(CACHE_DEFAULT_SIZE / (1024 * 1024))).c_str()), 0) * 1024 * 1024);
+	updateInfo.installAll = tolower(config.Get("install all", "n")[0]) == 'y';
+	updateInfo.verifyWrite = tolower(config.Get("verify write", "y")[0]) == 'y';
+	updateInfo.deltaManifest = config.Get("delta manifest", "");
+	updateInfo.syncMirror = config.Get("sync mirror", "");
+	updateInfo.stableManifest = config.Get("release manifest", "");
 
 	payloadType = config.Get("payload type", "a9lh");
 	if (payloadType == "a9lh") {
@@ -606,20 +621,22 @@ int main(int argc, char* argv[]) {
 	consoleSetProgressData("Detecting installed version", 0.3);
 	consoleScreen(GFX_BOTTOM);
 
+	// A previous update might have stopped before the new payload was renamed in place
+	if (!recoverPayload(updateInfo.payloadPath)) {
+		logPrintf("WARN: Could not clean up after interrupted update\n");
+	}
+
 	// Try to detect current version
 	logPrintf("Trying detection of current payload version...\n");
 
 	// Try using SVC 0x2E before falling back to the legacy method (memsearch)
 	updateInfo.currentVersion = versionSvc();
 	if (!updateInfo.currentVersion.isValid()) {
-		updateInfo.currentVersion = versionMemsearch(updateInfo.payloadPath);
+		updateInfo.currentVersion = versionDetect(updateInfo.payloadPath);
 	}
 
-	// Detect bak version, if exists
-	if (fileExists(updateInfo.payloadPath + ".bak")) {
-		updateInfo.backupExists = true;
-		updateInfo.backupVersion = versionMemsearch(updateInfo.payloadPath + ".bak");
-	}
+	// Bak version is detected when the confirmation screen needs it
+	updateInfo.backupExists = fileExists(updateInfo.payloadPath + ".bak");
 
 	// Check for eventual migration from ARN to Luma
 	updateInfo.migrateARN = arnVersionCheck(updateInfo.currentVersion);
@@ -630,8 +647,15 @@ int main(int argc, char* argv[]) {
 
 	updateInfo.stable = nullptr;
 	try {
-		release = releaseGetLatestStable();
+		release = releaseGetLatestStable(updateInfo.stableManifest);
 		updateInfo.stable = &release;
+		// The config wins over what the mirror suggests
+		if (updateInfo.deltaManifest.empty()) {
+			updateInfo.deltaManifest = release.deltaManifest;
+		}
+		if (updateInfo.syncMirror.empty()) {
+			updateInfo.syncMirror = release.syncMirror;
+		}
 	} catch (const std::runtime_error& e) {
 		logPrintf("%s\n", e.what());
 		logPrintf("\nFATAL ERROR\nFailed to obtain required data.\n\nPress START to exit.\n");
@@ -665,6 +689,10 @@ int main(int argc, char* argv[]) {
 
 		switch (state) {
 		case UpdateConfirmationScreen:
+			if (updateInfo.backupExists && !updateInfo.backupDetected) {
+				updateInfo.backupVersion = versionDetect(updateInfo.payloadPath + ".bak");
+				updateInfo.backupDetected = true;
+			}
 			updateInfo.choice = drawConfirmationScreen(updateInfo, configFound);
 			switch (updateInfo.choice.type) {
 			case ChoiceType::UpdatePayload:
@@ -703,9 +731,14 @@ int main(int argc, char* argv[]) {
 			if (redraw) {
 				consoleClear();
 				consolePrintHeader();
-				std::printf("\n  %sUpdate complete%s\n", CONSOLE_GREEN, CONSOLE_RESET);
-				if (updateInfo.backupExisting) {
-					std::printf("\n  In case something goes wrong you can restore\n  the old payload from %s.bak\n", updateInfo.payloadPath.c_str());
+				if (result.unchanged) {
+					std::printf("\n  %sAlready up to date%s\n", CONSOLE_GREEN, CONSOLE_RESET);
+					std::printf("\n  The installed payload is identical to the\n  downloaded one, nothing was written.\n");
+				} else {
+					std::printf("\n  %sUpdate complete%s\n", CONSOLE_GREEN, CONSOLE_RESET);
+					if (updateInfo.backupExisting) {
+						std::printf("\n  In case something goes wrong you can restore\n  the old payload from %s.bak\n", updateInfo.payloadPath.c_str());
+					}
 				}
 				std::printf("\n  Press START to reboot.");
 				redraw = false;
@@ -0,0 +1,110 @@
+#include "manifest.h"
+
+#include "utils.h"
+
+static bool isDevVersion(const std::string& filename) {
+	return filename.find("-dev.") < std::string::npos;
+}
+
+static ReleaseVer makeVersion(const std::string& filename, const std::string& url, const size_t fileSize, const std::string& digest) {
+	logPrintf("Found version: %s\n", filename.c_str());
+	return ReleaseVer{ filename, isDevVersion(filename) ? "developer version" : "normal version", url, fileSize, digest };
+}
+
+bool manifestParse(const u8* data, const size_t size, ReleaseInfo* release) {
+	const char* pos = (const char*)data;
+	const char* end = pos + size;
+	bool first = true;
+	while (pos < end) {
+		const char* lineEnd = std::find(pos, end, '\n');
+		std::string line(pos, lineEnd);
+		pos = lineEnd < end ? lineEnd + 1 : end;
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+
+		if (first) {
+			if (line != MANIFEST_MAGIC) {
+				return false;
+			}
+			first = false;
+			continue;
+		}
+
+		const size_t space = line.find(' ');
+		const std::string key = line.substr(0, space);
+		const std::string value = space != std::string::npos ? line.substr(space + 1) : "";
+		if (key == "name") {
+			release->name = value;
+			logPrintf("Release found: %s\n", release->name.c_str());
+		} else if (key == "asset") {
+			std::istringstream fields(value);
+			size_t fileSize;
+			std::string digest, filename, url;
+			if (!(fields >> fileSize >> digest >> filename >> url)) {
+				return false;
+			}
+			// Written in their final order (see manifestWrite), keep it
+			release->versions.push_back(makeVersion(filename, url, fileSize, digest == "-" ? "" : digest));
+		} else if (key == "delta") {
+			release->deltaManifest = value;
+		} else if (key == "sync") {
+			release->syncMirror = value;
+		} else if (key == "changelog") {
+			const size_t length = std::strtoul(value.c_str(), nullptr, 10);
+			if (length > (size_t)(end - pos)) {
+				return false;
+			}
+			release->description = std::string(pos, length);
+			logPrintf("Release description found.\n");
+			break;
+		}
+	}
+	return !first && !release->versions.empty();
+}
+
+std::string manifestWrite(const ReleaseInfo& release) {
+	std::string out = std::string(MANIFEST_MAGIC) + "\n";
+	out += "name " + release.name + "\n";
+	for (const ReleaseVer& version : release.versions) {
+		out += "asset " + tostr(version.fileSize) + " " + (version.digest.empty() ? "-" : version.digest) + " " + version.filename + " " + version.url + "\n";
+	}
+	if (!release.deltaManifest.empty()) {
+		out += "delta " + release.deltaManifest + "\n";
+	}
+	if (!release.syncMirror.empty()) {
+		out += "sync " + release.syncMirror + "\n";
+	}
+	out += "changelog " + tostr(release.description.size()) + "\n" + release.description;
+	return out;
+}
+
+void manifestFromGitHub(const GitHubRelease& github, ReleaseInfo* release) {
+	// Strip the "v" in front of the version name
+	release->name = github.name.compare(0, 1, "v") == 0 ? github.name.substr(1) : github.name;
+	logPrintf("Release found: %s\n", release->name.c_str());
+	release->description = github.body;
+	if (!github.body.empty()) {
+		logPrintf("Release description found.\n");
+	}
+	// Put normal version in front, dev on back
+	for (const GitHubAsset& asset : github.assets) {
+		const ReleaseVer version = makeVersion(asset.name, asset.url, asset.size, asset.digest);
+		if (!isDevVersion(asset.name)) {
+			release->versions.insert(release->versions.begin(), version);
+		} else {
+			release->versions.push_back(version);
+		}
+	}
+}
+
+bool manifestParseGitHub(const char* json, const size_t size, ReleaseInfo* release) {
+	GitHubRelease github;
+	GitHubReleaseReader reader(&github);
+	reader.feed((const u8*)json, size);
+	if (!reader.finish()) {
+		return false;
+	}
+	manifestFromGitHub(github, release);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "libs.h"
+
+#include "github.h"
+#include "release.h"
+
+/* Release manifests, served by a mirror instead of the GitHub API (see "release manifest"
+ * in the config). Text, one field per line, in any order except for the changelog:
+ *
+ *   LUMA-MANIFEST 1
+ *   name <release name>
+ *   asset <size> <digest or -> <file name> <url>   (one per version in order, see ReleaseVer)
+ *   delta <delta manifest url>                     (optional, see deltaupdate.h)
+ *   sync <block sync mirror url>                   (optional, see blocksync.h)
+ *   changelog <length>
+ *   <length bytes of changelog, as is>
+ *
+ * Unknown lines are skipped so fields can be added later. The changelog comes last and is
+ * length-prefixed, nothing in it needs escaping.
+ */
+#define MANIFEST_MAGIC "LUMA-MANIFEST 1"
+
+/*! \brief Parses a release manifest
+ *
+ * \param data    Manifest contents
+ * \param size    Size of the manifest in bytes
+ * \param release Release to fill
+ *
+ * \return true if the manifest is well formed and lists at least one version, false otherwise
+ */
+bool manifestParse(const u8* data, const size_t size, ReleaseInfo* release);
+
+/*! \brief Writes the release manifest of a release
+ *
+ * \param release Release to describe
+ *
+ * \return Manifest contents
+ */
+std::string manifestWrite(const ReleaseInfo& release);
+
+/*! \brief Gets the versions (assets) of a GitHub release
+ *
+ * \param github  Release read from the GitHub API
+ * \param release Release to fill
+ */
+void manifestFromGitHub(const GitHubRelease& github, ReleaseInfo* release);
+
+/*! \brief Gets a release out of a whole GitHub API release (see GitHubReleaseReader, manifestFromGitHub)
+ *
+ * \param json    JSON reply of the API
+ * \param size    Size of the reply in bytes
+ * \param release Release to fill
+ *
+ * \return true if the JSON could be parsed, false otherwise
+ */
+bool manifestParseGitHub(const char* json, const size_t size, ReleaseInfo* release);
\ No newline at end of file
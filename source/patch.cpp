@@ -0,0 +1,170 @@
+#include "patch.h"
+
+#include "utils.h"
+
+#include <stdexcept>
+
+// Automaton states are stored as u16
+#define PATCH_MAX_STATES 0xFFFF
+
+static size_t charSize(const PatchEncoding encoding) {
+	return encoding == PatchEncoding::UTF16 ? 2 : 1;
+}
+
+static std::string encode(const std::string& text, const PatchEncoding encoding) {
+	if (encoding == PatchEncoding::ASCII) {
+		return text;
+	}
+	std::string out(text.length() * 2, '\0');
+	for (size_t i = 0; i < text.length(); ++i) {
+		out[i * 2] = text[i];
+	}
+	return out;
+}
+
+// Characters written from the replacement start: the rest of the original text, or the
+// replacement plus its terminator when it's longer than that
+static size_t fieldLength(const PatchRule& rule, const std::string& needle) {
+	return std::max(needle.size() / charSize(rule.encoding) - rule.offset,
+	                rule.replacement.length() + (rule.terminated ? 1 : 0));
+}
+
+PatchSet::PatchSet(const std::vector<PatchRule>& rules) : ruleList(rules), firstByte(-1) {
+	// Build the trie, transitions to nowhere are 0 until the automaton is completed
+	std::vector<std::vector<u16>> trie(1, std::vector<u16>(256, 0));
+	outputs.resize(1);
+	for (size_t r = 0; r < ruleList.size(); ++r) {
+		const PatchRule& rule = ruleList[r];
+		std::string needle = encode(rule.needle, rule.encoding);
+		if (rule.terminated) {
+			needle.append(charSize(rule.encoding), '\0');
+		}
+		if (needle.empty()) {
+			throw std::runtime_error("Patch \"" + rule.name + "\" has an empty needle");
+		}
+		needles.push_back(needle);
+
+		const int first = (u8)needle[0];
+		firstByte = r == 0 || firstByte == first ? first : -1;
+
+		u16 state = 0;
+		for (const char c : needle) {
+			u16& next = trie[state][(u8)c];
+			if (next == 0) {
+				if (trie.size() >= PATCH_MAX_STATES) {
+					throw std::runtime_error("Too many patch rules");
+				}
+				next = trie.size();
+				trie.emplace_back(256, 0);
+				outputs.emplace_back();
+			}
+			state = next;
+		}
+		outputs[state].push_back(r);
+	}
+
+	// Fill the missing transitions with the ones of the longest proper suffix (breadth first)
+	std::vector<u16> fail(trie.size(), 0);
+	std::vector<u16> queue;
+	for (u16 c = 0; c < 256; ++c) {
+		if (trie[0][c] != 0) {
+			queue.push_back(trie[0][c]);
+		}
+	}
+	for (size_t q = 0; q < queue.size(); ++q) {
+		const u16 state = queue[q];
+		for (u16 c = 0; c < 256; ++c) {
+			u16& next = trie[state][c];
+			const u16 suffix = trie[fail[state]][c];
+			if (next == 0) {
+				next = suffix;
+				continue;
+			}
+			fail[next] = suffix;
+			outputs[next].insert(outputs[next].end(), outputs[suffix].begin(), outputs[suffix].end());
+			queue.push_back(next);
+		}
+	}
+
+	delta.reserve(trie.size() * 256);
+	for (const std::vector<u16>& row : trie) {
+		delta.insert(delta.end(), row.begin(), row.end());
+	}
+}
+
+std::vector<PatchMatch> PatchSet::find(const u8* buf, const size_t size) const {
+	std::vector<PatchMatch> matches;
+	if (needles.empty()) {
+		return matches;
+	}
+
+	u16 state = 0;
+	for (size_t i = 0; i < size; ++i) {
+		// Nothing partially matched, jump to the next possible start
+		if (state == 0 && firstByte >= 0) {
+			const u8* next = (const u8*)std::memchr(buf + i, firstByte, size - i);
+			if (next == nullptr) {
+				break;
+			}
+			i = next - buf;
+		}
+		state = delta[state * 256 + buf[i]];
+		for (const u16 r : outputs[state]) {
+			matches.push_back(PatchMatch{ r, i + 1 - needles[r].size() });
+		}
+	}
+
+	std::stable_sort(matches.begin(), matches.end(), [](const PatchMatch& a, const PatchMatch& b) {
+		return a.offset < b.offset;
+	});
+	return matches;
+}
+
+bool PatchSet::apply(u8* buf, const size_t size, std::vector<PatchMatch>* matches) const {
+	for (const PatchRule& rule : ruleList) {
+		if (rule.replacement.length() > rule.maxLength) {
+			logPrintf("Cannot apply %s: replacement too long (max %u chars)\n", rule.name.c_str(), (unsigned int)rule.maxLength);
+			return false;
+		}
+	}
+
+	std::vector<PatchMatch> found = find(buf, size);
+
+	std::vector<bool> matched(ruleList.size(), false);
+	for (const PatchMatch& match : found) {
+		const PatchRule& rule = ruleList[match.rule];
+		const size_t unit = charSize(rule.encoding);
+		if (match.offset + (rule.offset + fieldLength(rule, needles[match.rule])) * unit > size) {
+			logPrintf("Cannot apply %s at 0x%08x: payload too short\n", rule.name.c_str(), (unsigned int)match.offset);
+			return false;
+		}
+		matched[match.rule] = true;
+	}
+
+	for (size_t r = 0; r < ruleList.size(); ++r) {
+		if (ruleList[r].required && !matched[r]) {
+			logPrintf("Could not find \"%s\" (%s), is this even a valid payload?\n", ruleList[r].needle.c_str(), ruleList[r].name.c_str());
+			return false;
+		}
+	}
+
+	for (const PatchMatch& match : found) {
+		const PatchRule& rule = ruleList[match.rule];
+		const size_t unit = charSize(rule.encoding);
+
+		std::string field = rule.replacement;
+		field.resize(fieldLength(rule, needles[match.rule]), rule.padding);
+		if (rule.terminated) {
+			field.back() = '\0';
+		}
+		field = encode(field, rule.encoding);
+		std::memcpy(buf + match.offset + rule.offset * unit, field.data(), field.size());
+
+		logPrintf("Applied %s at 0x%08x\n", rule.name.c_str(), (unsigned int)match.offset);
+	}
+
+	if (matches != nullptr) {
+		*matches = found;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "libs.h"
+
+enum class PatchEncoding {
+	ASCII, // One byte per character
+	UTF16, // Two bytes per character, little endian
+};
+
+/*! \brief Declarative description of a string patch inside a payload
+ *
+ * The needle is searched as encoded text. On a match, `replacement` is written
+ * `offset` characters into it and the rest of the original text (terminator
+ * included) is filled with `padding`.
+ */
+struct PatchRule {
+	std::string   name;        /*!< Name used in logs                                     */
+	std::string   needle;      /*!< Text to look for (ASCII, encoded as `encoding`)       */
+	PatchEncoding encoding;    /*!< Encoding of the needle and replacement in the payload */
+	bool          terminated;  /*!< Needle must be followed by a NUL character            */
+	size_t        offset;      /*!< Character of the needle where the replacement starts  */
+	std::string   replacement; /*!< Text to write                                         */
+	size_t        maxLength;   /*!< Longest accepted replacement, in characters           */
+	char          padding;     /*!< Filler for the leftover characters                    */
+	bool          required;    /*!< Fail if the needle is not found                       */
+};
+
+/*! \brief Position of a rule's needle in a buffer */
+struct PatchMatch {
+	size_t rule;   /*!< Index of the rule in the set */
+	size_t offset; /*!< Byte offset of the needle    */
+};
+
+/*! \brief Set of patch rules matched together in a single pass
+ *
+ * Needles are compiled into an Aho-Corasick automaton, so the cost of a scan
+ * doesn't grow with the number of rules. When every needle starts with the
+ * same byte, memchr is used to skip ahead between candidates.
+ */
+class PatchSet {
+public:
+	/*! \brief Compiles a set of rules
+	 *
+	 * \param rules Rules to apply, throws if they are too large to compile
+	 */
+	PatchSet(const std::vector<PatchRule>& rules);
+
+	/*! \brief Looks for every rule's needle
+	 *
+	 * \param buf  Buffer to search
+	 * \param size Size of the buffer
+	 *
+	 * \return Matches sorted by offset
+	 */
+	std::vector<PatchMatch> find(const u8* buf, const size_t size) const;
+
+	/*! \brief Finds and patches every rule's needle in place
+	 *
+	 * Nothing is written unless every replacement fits and every required rule matched.
+	 *
+	 * \param buf     Buffer to patch
+	 * \param size    Size of the buffer
+	 * \param matches OPTIONAL Pointer to vector to fill with the patched offsets
+	 *
+	 * \return true if the buffer was patched, false otherwise
+	 */
+	bool apply(u8* buf, const size_t size, std::vector<PatchMatch>* matches = nullptr) const;
+
+	const std::vector<PatchRule>& rules() const { return ruleList; }
+
+private:
+	std::vector<PatchRule>        ruleList;
+	std::vector<std::string>      needles;   // Encoded needles, terminator included
+	std::vector<u16>              delta;     // Automaton transitions, 256 per state
+	std::vector<std::vector<u16>> outputs;   // Rules whose needle ends at each state
+	int                           firstByte; // Byte every needle starts with, or -1
+};
@@ -0,0 +1,43 @@
+#include "pipeline.h"
+
+#include "utils.h"
+
+void StageThread::entry(void* arg) {
+	((StageThread*)arg)->body();
+}
+
+bool StageThread::start(const std::function<void()>& func, const size_t stackSize) {
+	body = func;
+
+	// Lower is higher, 0x18 is the highest priority applications can use
+	s32 priority = 0x30;
+	svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+	thread = threadCreate(entry, this, stackSize, std::max(priority - 1, 0x18), -2, false);
+	return thread != nullptr;
+}
+
+void StageThread::join() {
+	if (thread == nullptr) {
+		return;
+	}
+	threadJoin(thread, U64_MAX);
+	threadFree(thread);
+	thread = nullptr;
+}
+
+static double ticksToSeconds(const u64 ticks) {
+	return (double)ticks / SYSCLOCK_ARM11;
+}
+
+static double throughput(const u64 bytes, const u64 ticks) {
+	return ticks > 0 ? (bytes / (1024.0 * 1024.0)) / ticksToSeconds(ticks) : 0.0;
+}
+
+void pipelinePrintStats(const std::vector<StageStats>& stages, const u64 totalTicks) {
+	u64 sumTicks = 0;
+	for (const StageStats& stage : stages) {
+		logPrintf("  %-8s busy %.2fs idle %.2fs (%.2f MB/s)\n", stage.name, ticksToSeconds(stage.busyTicks), ticksToSeconds(stage.idleTicks), throughput(stage.bytes, stage.busyTicks));
+		sumTicks += stage.busyTicks;
+	}
+	logPrintf("  total    %.2fs (stages alone: %.2fs)\n", ticksToSeconds(totalTicks), ticksToSeconds(sumTicks));
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "libs.h"
+
+/*! \brief Time a pipeline stage spent working and waiting on its neighbours (system ticks) */
+struct StageStats {
+	const char* name      = "";
+	u64         bytes     = 0; /*!< Bytes that went through the stage                */
+	u64         busyTicks = 0; /*!< Time spent working                               */
+	u64         idleTicks = 0; /*!< Time spent waiting for input or for queue room   */
+};
+
+/*! \brief Bounded single producer / single consumer queue between two stages
+ *
+ * Slots are handed over with semaphores, so a full queue blocks the producer and an
+ * empty one blocks the consumer. Time spent blocked is reported as idle time.
+ */
+template <typename T, u32 Size>
+class StageQueue {
+private:
+	T      items[Size];
+	Handle freeSlots;
+	Handle usedSlots;
+	u32    head = 0;
+	u32    tail = 0;
+
+public:
+	StageQueue() {
+		svcCreateSemaphore(&freeSlots, Size, Size);
+		svcCreateSemaphore(&usedSlots, 0, Size);
+	}
+
+	~StageQueue() {
+		svcCloseHandle(freeSlots);
+		svcCloseHandle(usedSlots);
+	}
+
+	/*! \brief Adds an item, waiting for a free slot
+	 *
+	 * \param item  Item to move into the queue
+	 * \param stats OPTIONAL Producer stage, waiting time is added to its idle time
+	 */
+	void push(T&& item, StageStats* stats = nullptr) {
+		const u64 start = svcGetSystemTick();
+		svcWaitSynchronization(freeSlots, U64_MAX);
+		if (stats != nullptr) {
+			stats->idleTicks += svcGetSystemTick() - start;
+		}
+		items[tail] = std::move(item);
+		tail = (tail + 1) % Size;
+		s32 count;
+		svcReleaseSemaphore(&count, usedSlots, 1);
+	}
+
+	/*! \brief Takes the oldest item, waiting for one to be available
+	 *
+	 * \param stats OPTIONAL Consumer stage, waiting time is added to its idle time
+	 */
+	T pop(StageStats* stats = nullptr) {
+		const u64 start = svcGetSystemTick();
+		svcWaitSynchronization(usedSlots, U64_MAX);
+		if (stats != nullptr) {
+			stats->idleTicks += svcGetSystemTick() - start;
+		}
+		T item = std::move(items[head]);
+		head = (head + 1) % Size;
+		s32 count;
+		svcReleaseSemaphore(&count, freeSlots, 1);
+		return item;
+	}
+};
+
+/*! \brief Runs a stage on its own thread
+ *
+ * Workers run just above the calling thread's priority, so they pick up work as soon as
+ * it's queued. Callers are expected to do the work inline when start() fails.
+ */
+class StageThread {
+private:
+	Thread                thread = nullptr;
+	std::function<void()> body;
+
+	static void entry(void* arg);
+
+public:
+	~StageThread() { join(); }
+
+	/*! \brief Starts the worker
+	 *
+	 * \param func      Stage loop
+	 * \param stackSize Stack size of the thread
+	 *
+	 * \return true if the thread is running, false if it couldn't be created
+	 */
+	bool start(const std::function<void()>& func, const size_t stackSize = 32 * 1024);
+
+	/*! \brief Waits for the worker to return (does nothing if it isn't running) */
+	void join();
+
+	bool running() const { return thread != nullptr; }
+};
+
+/*! \brief Print busy/idle time and throughput of every stage of a pipeline
+ *
+ * \param stages     Stages in pipeline order
+ * \param totalTicks Wall time of the whole pipeline
+ */
+void pipelinePrintStats(const std::vector<StageStats>& stages, const u64 totalTicks);
@@ -1,114 +1,67 @@
 #include "release.h"
 
-// jsmn includes
-#include "jsmn.h"
-
 // Internal includes
 #include "archive.h"
+#include "cache.h"
+#include "digest.h"
+#include "extract.h"
 #include "http.h"
+#include "manifest.h"
+#include "pipeline.h"
 #include "utils.h"
 
-#ifndef FAKEDL
-static int jsoneq(const char *json, const jsmntok_t *tok, const char *s) {
-	if (tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start &&
-		std::strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
-		return 0;
-	}
-	return -1;
-}
-#endif
-
-ReleaseInfo releaseGetLatestStable() {
+ReleaseInfo releaseGetLatestStable(const std::string& manifestURL) {
 	ReleaseInfo release;
 
 #ifdef FAKEDL
 	// Citra doesn't support HTTPc right now, so just fake a successful request
 	release.name = "5.2";
 	release.description = "- Remade the chainloader to only try to load the right payload for the pressed button. Now the only buttons which have a matching payload will actually do something during boot\r\n- Got rid of the default payload (start now boots \"start_NAME.bin\")\r\n- sel_NAME.bin is now select_NAME.bin as there are no more SFN/8.3 limitations anymore\r\n\r\nRefer to [the wiki](https://github.com/AuroraWright/Luma3DS/wiki/Installation-and-Upgrade#upgrading-from-v531) for upgrade instructions.";
-	release.versions.push_back(ReleaseVer{ "CITRA", "CITRA", "https://github.com/AuroraWright/Luma3DS/releases/download/v5.2/Luma3DSv5.2.7z", 143234 });
+	release.versions.push_back(ReleaseVer{ "CITRA", "CITRA", "https://github.com/AuroraWright/Luma3DS/releases/download/v5.2/Luma3DSv5.2.7z", 143234, "" });
+	(void)manifestURL;
 #else
 
-	static const char* ReleaseURL = "https://api.github.com/repos/AuroraWright/Luma3DS/releases/latest";
+	if (!manifestURL.empty()) {
+		u8* manifestData = nullptr;
+		u32 manifestSize = 0;
+		logPrintf("Downloading %s...\n", manifestURL.c_str());
+		try {
+			httpGet(manifestURL.c_str(), &manifestData, &manifestSize, true);
+			logPrintf("Downloaded %lu bytes\n", manifestSize);
+			if (manifestParse(manifestData, manifestSize, &release)) {
+				std::free(manifestData);
+				return release;
+			}
+			logPrintf("Release manifest is malformed\n");
+		} catch (const std::runtime_error& e) {
+			logPrintf("%s\n", e.what());
+		}
+		std::free(manifestData);
+		logPrintf("Asking GitHub instead...\n");
+		release = ReleaseInfo();
+	}
 
-	jsmn_parser p = {};
-	jsmn_init(&p);
+	static const char* ReleaseURL = "https://api.github.com/repos/AuroraWright/Luma3DS/releases/latest";
 
-	u8* apiReqData = nullptr;
 	u32 apiReqSize = 0;
 
 	logPrintf("Downloading %s...\n", ReleaseURL);
 
-	httpGet(ReleaseURL, &apiReqData, &apiReqSize, true);
+	// Parsed as it comes in, it's done as soon as the download is
+	GitHubRelease github;
+	GitHubReleaseReader reader(&github);
+	httpGetStream(ReleaseURL, [&reader](const u8* data, const u32 size) {
+		reader.feed(data, size);
+	}, &apiReqSize, true);
 
 	logPrintf("Downloaded %lu bytes\n", apiReqSize);
 	gfxFlushBuffers();
 
-	jsmntok_t t[512] = {};
-	int r = jsmn_parse(&p, (const char*)apiReqData, apiReqSize, t, sizeof(t) / sizeof(t[0]));
-	if (r < 0) {
-		throw formatErrMessage("Failed to parse JSON", r);
+	if (!reader.finish()) {
+		throw std::runtime_error("Failed to parse JSON");
 	}
 	logPrintf("JSON parsed successfully!\n");
-	gfxFlushBuffers();
-
-	bool namefound = false, bodyfound = false, inassets = false;
-	bool verHasName = false, verHasURL = false, verHasSize = false, isDev = false;
-	ReleaseVer current;
-	for (int i = 0; i < r; i++) {
-		if (!namefound && jsoneq((const char*)apiReqData, &t[i], "name") == 0) {
-			jsmntok_t val = t[i+1];
-			// Strip the "v" in front of the version name
-			if (apiReqData[val.start] == 'v') {
-				val.start += 1;
-			}
-			release.name = std::string((const char*)apiReqData + val.start, val.end - val.start);
-			logPrintf("Release found: %s\n", release.name.c_str());
-			namefound = true;
-		}
-		if (!bodyfound && jsoneq((const char*)apiReqData, &t[i], "body") == 0) {
-			jsmntok_t val = t[i+1];
-			release.description = unescape(std::string((const char*)apiReqData + val.start, val.end - val.start));
-			logPrintf("Release description found.\n");
-			bodyfound = true;
-		}
-		if (!inassets && jsoneq((const char*)apiReqData, &t[i], "assets") == 0) {
-			inassets = true;
-		}
-		if (inassets) {
-			if (jsoneq((const char*)apiReqData, &t[i], "name") == 0) {
-				jsmntok_t val = t[i+1];
-				current.filename = std::string((const char*)apiReqData + val.start, val.end - val.start);
-				isDev = current.filename.find("-dev.") < std::string::npos;
-				current.friendlyName = isDev ? "developer version" : "normal version";
-				verHasName = true;
-			}
-			if (jsoneq((const char*)apiReqData, &t[i], "browser_download_url") == 0) {
-				jsmntok_t val = t[i+1];
-				current.url = std::string((const char*)apiReqData + val.start, val.end - val.start);
-				verHasURL = true;
-			}
-			if (jsoneq((const char*)apiReqData, &t[i], "size") == 0) {
-				jsmntok_t val = t[i + 1];
-				std::string sizeStr = std::string((const char*)apiReqData + val.start, val.end - val.start);
-				current.fileSize = std::atoi(sizeStr.c_str());
-				verHasSize = true;
-			}
-			if (verHasName && verHasURL && verHasSize) {
-				logPrintf("Found version: %s\n", current.filename.c_str());
-				ReleaseVer version = ReleaseVer{ current.filename, current.friendlyName, current.url, current.fileSize };
-				// Put normal version in front, dev on back
-				if (!isDev) {
-					release.versions.insert(release.versions.begin(), version);
-				} else {
-					release.versions.push_back(version);
-				}
-				verHasName = verHasURL = verHasSize = isDev = false;
-			}
-		}
-	}
-
-	gfxFlushBuffers();
-	std::free(apiReqData);
+	manifestFromGitHub(github, &release);
 
 #endif
 
@@ -121,7 +74,7 @@ ReleaseInfo releaseGetLatestHourly() {
 #ifdef FAKEDL
 	// Citra doesn't support HTTPc right now, so just fake a successful request
 	hourly.name = "aaaaaaa";
-	hourly.versions.push_back(ReleaseVer{ "CITRA", "latest hourly (aaaaaaa)", "https://github.com/AuroraWright/Luma3DS/releases/download/v5.2/Luma3DSv5.2.7z", 143234 });
+	hourly.versions.push_back(ReleaseVer{ "CITRA", "latest hourly (aaaaaaa)", "https://github.com/AuroraWright/Luma3DS/releases/download/v5.2/Luma3DSv5.2.7z", 143234, "" });
 #else
 
 	static const char* LastCommitURL = "https://raw.githubusercontent.com/astronautlevel2/Luma3DS/gh-pages/lastCommit";
@@ -163,7 +116,7 @@ ReleaseInfo releaseGetLatestHourly() {
 
 		std::string url = verurls[i] + hourlyName + ".zip";
 
-		hourly.versions.push_back(ReleaseVer { hourlyName, "latest " + std::string(vertypes[i]) + " (" + hourlyName + ")", std::string(url), 0 });
+		hourly.versions.push_back(ReleaseVer { hourlyName, "latest " + std::string(vertypes[i]) + " (" + hourlyName + ")", std::string(url), 0, "" });
 		hourly.commits[std::string(vertypes[i])] = hourlyName;
 
 		std::free(apiReqData);
@@ -174,29 +127,102 @@ ReleaseInfo releaseGetLatestHourly() {
 	return hourly;
 }
 
-bool releaseGetPayload(const PayloadType payloadType, const ReleaseVer& release, const bool isHourly, u8** payloadData, size_t* offset, size_t* payloadSize) {
-	u8* fileData = nullptr;
-	u32 fileSize = 0;
-	HTTPResponseInfo info;
+// Received pieces of the archive waiting to be hashed
+#define HASH_QUEUE_SIZE 32
+#define HASH_STACK_SIZE (16 * 1024)
+#ifdef FAKEDL
+#define FAKEDL_CHUNK_SIZE (64 * 1024)
+#endif
+
+struct HashChunk {
+	const u8* data = nullptr;
+	u32       size = 0; //!< 0 to stop the hasher
+};
+
+// Downloads a release archive while a worker hashes what has been received so far,
+// so the digests are ready (almost) as soon as the last byte arrives
+static bool releaseDownload(const ReleaseVer& release, u8** fileData, u32* fileSize, HTTPResponseInfo* info, DigestResult* digests) {
+	StageStats receive, hash;
+	receive.name = "receive";
+	hash.name = "hash";
+
+	Digest digest;
+	auto hashChunk = [&digest, &hash](const HashChunk& chunk) {
+		const u64 start = svcGetSystemTick();
+		digest.update(chunk.data, chunk.size);
+		hash.busyTicks += svcGetSystemTick() - start;
+		hash.bytes += chunk.size;
+	};
 
+	// If the hasher can't be created, chunks are hashed as they come in
+	StageQueue<HashChunk, HASH_QUEUE_SIZE> queue;
+	StageThread hasher;
+	hasher.start([&queue, &hash, &hashChunk]() {
+		for (HashChunk chunk = queue.pop(&hash); chunk.size > 0; chunk = queue.pop(&hash)) {
+			hashChunk(chunk);
+		}
+	}, HASH_STACK_SIZE);
+
+	// Headers are in by the first piece, so a multipart ETag can be tracked from the start
+	bool started = false;
+	auto onReceive = [&queue, &hasher, &receive, &hashChunk, &digest, &started, info, fileSize](const u8* data, const u32 size) {
+		if (!started) {
+			ExpectedDigest etag;
+			if (digestParse(info->etag, "ETag", &etag)) {
+				digest.trackParts(etag, *fileSize);
+			}
+			started = true;
+		}
+		HashChunk chunk;
+		chunk.data = data;
+		chunk.size = size;
+		if (hasher.running()) {
+			queue.push(std::move(chunk), &receive);
+		} else {
+			hashChunk(chunk);
+		}
+	};
+
+	const u64 start = svcGetSystemTick();
+	bool ok = true;
 	try {
 #ifdef FAKEDL
 		// Read predownloaded file
 		std::ifstream predownloaded(release.filename + ".7z", std::ios::binary | std::ios::ate);
-		fileSize = predownloaded.tellg();
+		*fileSize = predownloaded.tellg();
 		predownloaded.seekg(0, std::ios::beg);
-		fileData = (u8*)malloc(fileSize);
-		predownloaded.read((char*)fileData, fileSize);
-		info.etag = "\"0973d3d5fe62fccc30c8f663aec6918c\"";
+		*fileData = (u8*)malloc(*fileSize);
+		info->etag = "\"0973d3d5fe62fccc30c8f663aec6918c\"";
+		for (u32 pos = 0; pos < *fileSize; pos += FAKEDL_CHUNK_SIZE) {
+			const u32 size = std::min<u32>(FAKEDL_CHUNK_SIZE, *fileSize - pos);
+			predownloaded.read((char*)*fileData + pos, size);
+			onReceive(*fileData + pos, size);
+		}
 #else
-		httpGet(release.url.c_str(), &fileData, &fileSize, true, &info);
+		httpGet(release.url.c_str(), fileData, fileSize, true, info, onReceive);
 #endif
 	} catch (const std::runtime_error& e) {
 		logPrintf("%s\n", e.what());
-		return false;
+		ok = false;
+	}
+	receive.busyTicks = svcGetSystemTick() - start - receive.idleTicks;
+	receive.bytes = *fileSize;
+
+	if (hasher.running()) {
+		queue.push(HashChunk());
+		hasher.join();
+	}
+	*digests = digest.finish();
+
+	if (ok) {
+		logPrintf("Download complete! Size: %lu\n", *fileSize);
+		pipelinePrintStats({ receive, hash }, svcGetSystemTick() - start);
 	}
-	logPrintf("Download complete! Size: %lu\n", fileSize);
+	return ok;
+}
 
+// Checks a downloaded archive against everything known about it
+static bool releaseVerify(const ReleaseVer& release, const u32 fileSize, const HTTPResponseInfo& info, const DigestResult& digests) {
 	if (release.fileSize != 0) {
 		logPrintf("Integrity check #1");
 		if (fileSize != release.fileSize) {
@@ -209,42 +235,90 @@ bool releaseGetPayload(const PayloadType payloadType, const ReleaseVer& release,
 		logPrintf("Skipping integrity check #1 (unknown size)\n");
 	}
 
-	if (!info.etag.empty()) {
-		logPrintf("Integrity check #2");
-		if (!httpCheckETag(info.etag, fileData, fileSize)) {
-			logPrintf(" [ERR]\r\nMD5 mismatch between server's and local file!\n");
-			gfxFlushBuffers();
-			return false;
+	// Digests were computed during the download, checking them is just a comparison
+	std::vector<ExpectedDigest> expected;
+	ExpectedDigest parsed;
+	if (!release.digest.empty() && digestParse(release.digest, "release", &parsed)) {
+		expected.push_back(parsed);
+	}
+	if (!info.etag.empty() && digestParse(info.etag, "ETag", &parsed)) {
+		expected.push_back(parsed);
+	}
+
+	if (!expected.empty()) {
+		for (const ExpectedDigest& check : expected) {
+			logPrintf("Integrity check #2 (%s %s)", check.source.c_str(), digestName(check.type));
+			if (!digestMatches(digests, check)) {
+				logPrintf(" [ERR]\r\n%s mismatch between server's and local file!\n", digestName(check.type));
+				gfxFlushBuffers();
+				return false;
+			}
+			logPrintf(" [OK]\r\n");
 		}
-		logPrintf(" [OK]\r\n");
 	} else {
-		logPrintf("Skipping integrity check #2 (no ETag found)\n");
+		logPrintf("Skipping integrity check #2 (no digest found)\n");
 	}
+	return true;
+}
 
-	logPrintf("\nExtracting payload");
-	gfxFlushBuffers();
-
-	std::string payloadPath;
+std::string releasePayloadPath(const PayloadType payloadType) {
 	switch (payloadType) {
 	case PayloadType::A9LH:
-		payloadPath = DEFAULT_A9LH_PATH;
-		break;
+		return DEFAULT_A9LH_PATH;
 	case PayloadType::Menuhax:
-		payloadPath = DEFAULT_MHAX_PATH;
-		break;
+		return DEFAULT_MHAX_PATH;
 	case PayloadType::Homebrew:
-		payloadPath = DEFAULT_3DSX_PATH;
-		break;
+		return DEFAULT_3DSX_PATH;
 	}
+	return DEFAULT_A9LH_PATH;
+}
+
+bool releaseGetPayload(const PayloadType payloadType, const ReleaseVer& release, const bool isHourly, const bool useCache, ArchiveBuffer* payload, ReleaseArchive* installAll) {
+	const std::string payloadPath = releasePayloadPath(payloadType);
+
+	// Installing everything needs the archive
+	if (useCache && installAll == nullptr && cacheGetPayload(release, payloadPath, payload)) {
+		logPrintf("Using cached %s from %s\n", payloadPath.c_str(), release.filename.c_str());
+		return true;
+	}
+
+	// Switching between cached releases doesn't need the network at all
+	u8* fileData = nullptr;
+	u32 fileSize = 0;
+	if (useCache && cacheGetArchive(release, &fileData, &fileSize)) {
+		logPrintf("Using cached %s (%lu bytes)\n", release.filename.c_str(), fileSize);
+	} else {
+		HTTPResponseInfo info;
+		DigestResult digests;
+		if (!releaseDownload(release, &fileData, &fileSize, &info, &digests) || !releaseVerify(release, fileSize, info, digests)) {
+			std::free(fileData);
+			return false;
+		}
+	}
+
+	logPrintf("\nExtracting payload");
+	gfxFlushBuffers();
+
+	const std::string prefix = isHourly ? "out/" : "";
+	std::map<std::string, ArchiveBuffer> variants;
+	std::unique_ptr<Archive> archive;
 
 	try {
-		if (isHourly) {
-			ZipArchive archive(fileData, fileSize);
-			archive.extractFile(std::string("out/") + payloadPath, payloadData, payloadSize);
-			offset = 0;
-		} else {
-			SzArchive archive(fileData, fileSize);
-			archive.extractFile(payloadPath, payloadData, payloadSize, offset);
+		archive = Archive::open(fileData, fileSize);
+		if (useCache) {
+			// Get every variant while the archive is decoded, they usually share a block
+			static const char* variantPaths[] = { DEFAULT_A9LH_PATH, DEFAULT_MHAX_PATH, DEFAULT_3DSX_PATH };
+			for (const char* variant : variantPaths) {
+				// Not every release ships every payload
+				if (variant != payloadPath && archive->contains(prefix + variant)) {
+					variants[variant] = archive->extractFile(prefix + variant);
+				}
+			}
+		}
+		*payload = archive->extractFile(prefix + payloadPath);
+		variants[payloadPath] = *payload;
+		if (archive->peakMemory() > 0) {
+			logPrintf(" (%u KiB peak, %lu allocs)", archive->peakMemory() / 1024, archive->allocCount());
 		}
 	} catch (const std::runtime_error& e) {
 		logPrintf(" [ERR]\nFATAL: %s", e.what());
@@ -253,6 +327,31 @@ bool releaseGetPayload(const PayloadType payloadType, const ReleaseVer& release,
 	}
 
 	logPrintf(" [OK]\n");
+
+	if (useCache) {
+		logPrintf("Caching archive and %u payloads...", (unsigned)variants.size());
+		logPrintf(cacheStore(release, fileData, fileSize, variants) ? " [OK]\n" : " [ERR]\n");
+	}
+
+	// The rest is installed once the payload is in place
+	if (installAll != nullptr) {
+		installAll->data.reset(fileData, std::free);
+		installAll->archive = std::move(archive);
+		installAll->prefix = prefix;
+		installAll->payloadPath = payloadPath;
+		return true;
+	}
+	archive.reset();
 	std::free(fileData);
 	return true;
+}
+
+bool releaseInstallAll(ReleaseArchive& release) {
+	logPrintf("Installing every file from the archive...\n");
+	gfxFlushBuffers();
+
+	ExtractStats stats;
+	const bool ok = extractAll(*release.archive, release.prefix, { release.payloadPath }, &stats);
+	extractPrintStats(stats);
+	return ok;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "libs.h"
 
+#include "archive.h"
+
 #define DEFAULT_A9LH_PATH "arm9loaderhax.bin"
 #define DEFAULT_MHAX_PATH "Luma3DS.dat"
 #define DEFAULT_3DSX_PATH "3DS/Luma3DS/Luma3DS.3dsx"
@@ -17,6 +19,7 @@ struct ReleaseVer {
 	std::string friendlyName;
 	std::string url;
 	size_t      fileSize;
+	std::string digest; //!< Expected digest of the archive ("sha256:<hex>"), empty if unknown
 };
 
 struct ReleaseInfo {
@@ -24,13 +27,31 @@ struct ReleaseInfo {
 	std::string description = "";
 	std::vector<ReleaseVer> versions = {};
 	std::map<std::string, std::string> commits = {};
+	std::string deltaManifest = ""; //!< Delta manifest the release manifest points to
+	std::string syncMirror = "";    //!< Block sync mirror the release manifest points to
+};
+
+/*! \brief Release archive kept open after its payload was taken out (see releaseGetPayload)
+ *
+ * The other files are only installed once the payload is saved and verified, so a failed
+ * payload install leaves the rest of the SD card as it was.
+ */
+struct ReleaseArchive {
+	std::shared_ptr<u8>      data;        //!< Archive bytes (the archive reads from them)
+	std::unique_ptr<Archive> archive;
+	std::string              prefix;      //!< Where files are in the archive ("out/" for hourlies)
+	std::string              payloadPath; //!< Payload inside the archive, installed separately
 };
 
 /* \brief Gets last official release (from Aurora's Github)
+ * With a release manifest URL, the much smaller manifest (see manifest.h) is used instead,
+ * GitHub is only asked if it can't be downloaded or parsed.
+ *
+ * \param manifestURL OPTIONAL Release manifest URL
  *
  * \return ReleaseInfo containing the last release name and available versions
  */
-ReleaseInfo releaseGetLatestStable();
+ReleaseInfo releaseGetLatestStable(const std::string& manifestURL = "");
 
 /* \brief Gets the latest available hourly build (from astronautlevel2's website) 
  *
@@ -38,18 +59,34 @@ ReleaseInfo releaseGetLatestStable();
  */
 ReleaseInfo releaseGetLatestHourly();
 
+/* \brief Path of a payload type inside release archives (eg. DEFAULT_A9LH_PATH) */
+std::string releasePayloadPath(const PayloadType type);
+
 /* \brief Update to stable version
  * Gets the chosen payload (A9LH/Menuhax/3dsx) file from either a stable release or a hourly
- * The buffer must be free'd after used. If the release is not an hourly, the `payloadData` pointer must
- * increased by `offset` to get the correct bytes
+ * The archive format (zip/7z) is detected from the downloaded data, `isHourly` only affects
+ * where the payload is looked for inside the archive.
  *
  * \param type        Payload type to fetch
  * \param release     Release data
- * \param isHourly    Wether the release is a hourly (.zip) or stable (.7z)
- * \param payloadData Pointer to fill with the payload bytes (should be nullptr when passing)
- * \param offset      Pointer to fill with the offset to the correct bytes (if 7z)
- * \param payloadSize Pointer to fill with size (in bytes) of the payload
+ * When `useCache` is set, the payload is taken from the on-SD cache if present, then the
+ * archive is taken from the cache (or downloaded), and it's cached along with every payload
+ * variant (extracted in one pass) for later installs.
+ *
+ * \param isHourly    Wether the release is a hourly (payload is under out/) or stable
+ * \param useCache    Use and fill the archive and payload cache
+ * \param payload     Buffer to fill with the payload bytes
+ * \param installAll  OPTIONAL Archive to keep open to install every other file later
+ *                    (see releaseInstallAll), the payload cache isn't used then
  *
  * \return true if everything succeeds, false otherwise
  */
-bool releaseGetPayload(const PayloadType type, const ReleaseVer& release, const bool isHourly, u8** payloadData, size_t* offset, size_t* payloadSize);
\ No newline at end of file
+bool releaseGetPayload(const PayloadType type, const ReleaseVer& release, const bool isHourly, const bool useCache, ArchiveBuffer* payload, ReleaseArchive* installAll = nullptr);
+
+/* \brief Writes every file of a release archive but the payload to its path on the SD card
+ *
+ * \param release Archive kept open by releaseGetPayload
+ *
+ * \return true if every file was written, false otherwise
+ */
+bool releaseInstallAll(ReleaseArchive& release);
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "sdwriter.h"
+
+#include <stdexcept>
+
+#ifdef _3DS
+#include "unicode.h"
+
+// FS error for "directory already exists"
+#define FS_ERR_ALREADY_EXISTS 0xC82044BE
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _3DS
+
+SdWriter::SdWriter(const u32 chunkSize) {
+	if (FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, NULL)) != 0) {
+		throw std::runtime_error("Could not access SD Card");
+	}
+	FS_ArchiveResource resource;
+	if (FSUSER_GetSdmcArchiveResource(&resource) == 0) {
+		clusterSize = resource.clusterSize;
+	}
+	chunk = chunkSize > 0 ? chunkSize : SD_CHUNK_SIZE;
+	if (clusterSize > 0) {
+		chunk = (chunk + clusterSize - 1) / clusterSize * clusterSize;
+	}
+}
+
+SdWriter::~SdWriter() {
+	FSUSER_CloseArchive(sdmc);
+}
+
+bool SdWriter::write(const std::string& path, const u8* data, const size_t size) {
+	Handle handle;
+	const std::u16string path16 = utf8ToUtf16(path);
+	if (FSUSER_OpenFile(&handle, sdmc, fsMakePath(PATH_UTF16, path16.c_str()), FS_OPEN_WRITE | FS_OPEN_CREATE, 0) != 0) {
+		return false;
+	}
+
+	// Allocate the whole file at once (this also drops any old contents past the end)
+	bool ok = FSFILE_SetSize(handle, size) == 0;
+	for (size_t offset = 0; ok && offset < size; offset += chunk) {
+		const u32 length = (u32)std::min((size_t)chunk, size - offset);
+		const bool last = offset + length == size;
+		u32 written = 0;
+		ok = FSFILE_Write(handle, &written, offset, data + offset, length, last ? FS_WRITE_FLUSH : 0) == 0 && written == length;
+	}
+	if (ok && size == 0) {
+		ok = FSFILE_Flush(handle) == 0;
+	}
+
+	u64 finalSize = 0;
+	ok = ok && FSFILE_GetSize(handle, &finalSize) == 0 && finalSize == size;
+
+	FSFILE_Close(handle);
+	return ok;
+}
+
+bool SdWriter::openRead(const std::string& path, ReadHandle* handle, u64* size) {
+	const std::u16string path16 = utf8ToUtf16(path);
+	if (FSUSER_OpenFile(handle, sdmc, fsMakePath(PATH_UTF16, path16.c_str()), FS_OPEN_READ, 0) != 0) {
+		return false;
+	}
+	if (FSFILE_GetSize(*handle, size) != 0) {
+		FSFILE_Close(*handle);
+		return false;
+	}
+	return true;
+}
+
+bool SdWriter::read(const ReadHandle handle, const u64 offset, u8* buffer, const u32 length) {
+	u32 read = 0;
+	return FSFILE_Read(handle, &read, offset, buffer, length) == 0 && read == length;
+}
+
+void SdWriter::closeRead(const ReadHandle handle) {
+	FSFILE_Close(handle);
+}
+
+bool SdWriter::rename(const std::string& source, const std::string& target) {
+	const std::u16string source16 = utf8ToUtf16(source);
+	const std::u16string target16 = utf8ToUtf16(target);
+	return FSUSER_RenameFile(sdmc, fsMakePath(PATH_UTF16, source16.c_str()), sdmc, fsMakePath(PATH_UTF16, target16.c_str())) == 0;
+}
+
+bool SdWriter::remove(const std::string& path) {
+	const std::u16string path16 = utf8ToUtf16(path);
+	return FSUSER_DeleteFile(sdmc, fsMakePath(PATH_UTF16, path16.c_str())) == 0;
+}
+
+bool SdWriter::createDirectory(const std::string& path, bool* existed) {
+	const std::u16string path16 = utf8ToUtf16(path);
+	const Result res = FSUSER_CreateDirectory(sdmc, fsMakePath(PATH_UTF16, path16.c_str()), FS_ATTRIBUTE_DIRECTORY);
+	if (existed != nullptr) {
+		*existed = (u32)res == FS_ERR_ALREADY_EXISTS;
+	}
+	return res == 0 || (u32)res == FS_ERR_ALREADY_EXISTS;
+}
+
+bool SdWriter::exists(const std::string& path) {
+	Handle handle;
+	const std::u16string path16 = utf8ToUtf16(path);
+	if (FSUSER_OpenFile(&handle, sdmc, fsMakePath(PATH_UTF16, path16.c_str()), FS_OPEN_READ, 0) != 0) {
+		return false;
+	}
+	FSFILE_Close(handle);
+	return true;
+}
+
+#else
+
+// Host builds: paths are used as they are
+SdWriter::SdWriter(const u32 chunkSize) {
+	struct stat info;
+	if (stat(".", &info) == 0) {
+		clusterSize = info.st_blksize;
+	}
+	chunk = chunkSize > 0 ? chunkSize : SD_CHUNK_SIZE;
+	if (clusterSize > 0) {
+		chunk = (chunk + clusterSize - 1) / clusterSize * clusterSize;
+	}
+}
+
+SdWriter::~SdWriter() {}
+
+bool SdWriter::write(const std::string& path, const u8* data, const size_t size) {
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+	if (fd < 0) {
+		return false;
+	}
+
+	bool ok = ftruncate(fd, size) == 0;
+	for (size_t offset = 0; ok && offset < size; offset += chunk) {
+		const size_t length = std::min((size_t)chunk, size - offset);
+		ok = pwrite(fd, data + offset, length, offset) == (ssize_t)length;
+	}
+	ok = ok && fsync(fd) == 0;
+
+	struct stat info;
+	ok = ok && fstat(fd, &info) == 0 && (size_t)info.st_size == size;
+
+	close(fd);
+	return ok;
+}
+
+bool SdWriter::openRead(const std::string& path, ReadHandle* handle, u64* size) {
+	*handle = open(path.c_str(), O_RDONLY);
+	if (*handle < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(*handle, &info) != 0) {
+		close(*handle);
+		return false;
+	}
+	*size = info.st_size;
+	return true;
+}
+
+bool SdWriter::read(const ReadHandle handle, const u64 offset, u8* buffer, const u32 length) {
+	return pread(handle, buffer, length, offset) == (ssize_t)length;
+}
+
+void SdWriter::closeRead(const ReadHandle handle) {
+	close(handle);
+}
+
+bool SdWriter::rename(const std::string& source, const std::string& target) {
+	return std::rename(source.c_str(), target.c_str()) == 0;
+}
+
+bool SdWriter::remove(const std::string& path) {
+	return std::remove(path.c_str()) == 0;
+}
+
+bool SdWriter::createDirectory(const std::string& path, bool* existed) {
+	const int res = mkdir(path.c_str(), 0755);
+	if (existed != nullptr) {
+		*existed = res != 0 && errno == EEXIST;
+	}
+	return res == 0 || errno == EEXIST;
+}
+
+bool SdWriter::exists(const std::string& path) {
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+#endif
+
+bool SdWriter::replace(const std::string& path, const u8* data, const size_t size, const std::string& backupPath) {
+	// Only a complete file gets the temp name, so a leftover temp file is always usable
+	const std::string partialPath = path + SD_PARTIAL_SUFFIX;
+	const std::string tempPath = path + SD_TEMP_SUFFIX;
+	remove(tempPath);
+	if (!write(partialPath, data, size) || !rename(partialPath, tempPath)) {
+		remove(partialPath);
+		return false;
+	}
+
+	const bool hadOriginal = exists(path);
+	const bool keepBackup = hadOriginal && !backupPath.empty();
+
+	// FAT can't rename over an existing file, so the old one has to move out of the way first
+	if (keepBackup) {
+		remove(backupPath);
+		if (!rename(path, backupPath)) {
+			remove(tempPath);
+			return false;
+		}
+	} else if (hadOriginal && !remove(path)) {
+		remove(tempPath);
+		return false;
+	}
+
+	if (!rename(tempPath, path)) {
+		// Put the old file back where it was
+		if (keepBackup) {
+			rename(backupPath, path);
+		}
+		return false;
+	}
+	return true;
+}
+
+
+bool SdWriter::identical(const std::string& path, const u8* data, const size_t size) {
+	ReadHandle handle;
+	u64 fileSize = 0;
+	if (!openRead(path, &handle, &fileSize)) {
+		return false;
+	}
+
+	bool same = fileSize == size;
+	std::unique_ptr<u8[]> buffer(same && size > 0 ? new u8[std::min((size_t)chunk, size)] : nullptr);
+	for (size_t offset = 0; same && offset < size; offset += chunk) {
+		const u32 length = (u32)std::min((size_t)chunk, size - offset);
+		same = read(handle, offset, buffer.get(), length) && std::memcmp(buffer.get(), data + offset, length) == 0;
+	}
+
+	closeRead(handle);
+	return same;
+}
+
+bool SdWriter::readFile(const std::string& path, std::shared_ptr<u8>* data, u64* size) {
+	ReadHandle handle;
+	if (!openRead(path, &handle, size)) {
+		return false;
+	}
+
+	data->reset((u8*)std::malloc(std::max<size_t>(*size, 1)), std::free);
+	bool ok = *data != nullptr;
+	for (u64 offset = 0; ok && offset < *size; offset += chunk) {
+		ok = read(handle, offset, data->get() + offset, (u32)std::min<u64>(chunk, *size - offset));
+	}
+
+	closeRead(handle);
+	if (!ok) {
+		data->reset();
+	}
+	return ok;
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "libs.h"
+
+// Files replaced by SdWriter::replace are written as "<path>.part", renamed to
+// "<path>.new" once complete, then renamed in place
+#define SD_PARTIAL_SUFFIX ".part"
+#define SD_TEMP_SUFFIX    ".new"
+// Default write size, rounded up to a whole number of FAT clusters
+#define SD_CHUNK_SIZE (256 * 1024)
+
+/*! \brief Writes whole files to the SD card
+ *
+ * Files are preallocated, written in large chunks at cluster-aligned offsets, flushed,
+ * then checked for their final size. Every install path (payloads, extracted archives,
+ * updater files) goes through here, and so do read-backs of what was installed.
+ * Host builds (tools/) use POSIX calls instead of FS.
+ */
+class SdWriter {
+private:
+#ifdef _3DS
+	FS_Archive sdmc;
+#endif
+	u32 clusterSize = 0;
+	u32 chunk = SD_CHUNK_SIZE;
+
+public:
+#ifdef _3DS
+	typedef Handle ReadHandle;
+#else
+	typedef int ReadHandle;
+#endif
+
+	/*! \brief Opens the SD card, throws std::runtime_error if it can't
+	 *
+	 * \param chunkSize Bytes per write, 0 picks SD_CHUNK_SIZE. Rounded up to the cluster size.
+	 */
+	SdWriter(const u32 chunkSize = 0);
+	~SdWriter();
+
+	/*! \brief Writes a file, replacing it if it exists (not atomic, see replace)
+	 *
+	 * \param path Absolute path on SD (UTF-8)
+	 * \param data File bytes
+	 * \param size Size of the file in bytes
+	 *
+	 * \return true if every byte was written and the file has the expected size
+	 */
+	bool write(const std::string& path, const u8* data, const size_t size);
+
+	/*! \brief Writes a file through a temp file renamed in place once complete
+	 *
+	 * If anything fails, the original file is left as it was.
+	 *
+	 * \param path       Absolute path on SD (UTF-8)
+	 * \param data       File bytes
+	 * \param size       Size of the file in bytes
+	 * \param backupPath OPTIONAL Path to move the original file to (replacing it), deleted otherwise
+	 *
+	 * \return true if the new file is in place, false otherwise
+	 */
+	bool replace(const std::string& path, const u8* data, const size_t size, const std::string& backupPath = "");
+
+	/*! \brief Checks whether a file already holds exactly the given bytes
+	 *
+	 * The size is checked first, then the file is read back in chunks and compared as it
+	 * goes, stopping at the first difference.
+	 *
+	 * \param path Absolute path on SD (UTF-8)
+	 * \param data Expected file bytes
+	 * \param size Expected size of the file in bytes
+	 *
+	 * \return true if the file exists and has the same contents, false otherwise
+	 */
+	bool identical(const std::string& path, const u8* data, const size_t size);
+
+	/*! \brief Opens a file for reading (see read, closeRead)
+	 *
+	 * \param path   Absolute path on SD (UTF-8)
+	 * \param handle Handle to fill
+	 * \param size   Size of the file in bytes
+	 *
+	 * \return true if the file was opened, false otherwise
+	 */
+	bool openRead(const std::string& path, ReadHandle* handle, u64* size);
+
+	/*! \brief Reads part of a file opened with openRead
+	 *
+	 * \return true if exactly `length` bytes were read, false otherwise
+	 */
+	bool read(const ReadHandle handle, const u64 offset, u8* buffer, const u32 length);
+
+	/*! \brief Closes a file opened with openRead */
+	void closeRead(const ReadHandle handle);
+
+	/*! \brief Reads a whole file in memory
+	 *
+	 * \param path Absolute path on SD (UTF-8)
+	 * \param data Buffer to fill (allocated with malloc)
+	 * \param size Size of the file in bytes
+	 *
+	 * \return true if the whole file was read, false otherwise
+	 */
+	bool readFile(const std::string& path, std::shared_ptr<u8>* data, u64* size);
+
+	/*! \brief Checks whether a file exists
+	 *
+	 * \param path Absolute path on SD (UTF-8)
+	 *
+	 * \return true if there is a file (not a directory) at that path
+	 */
+	bool exists(const std::string& path);
+
+	/*! \brief Renames a file
+	 *
+	 * \return true on success, false otherwise
+	 */
+	bool rename(const std::string& source, const std::string& target);
+
+	/*! \brief Deletes a file
+	 *
+	 * \return true on success, false otherwise
+	 */
+	bool remove(const std::string& path);
+
+	/*! \brief Creates a directory
+	 *
+	 * \param path    Absolute path on SD (UTF-8)
+	 * \param existed OPTIONAL Set to true if the directory was already there
+	 *
+	 * \return true if the directory exists, false otherwise
+	 */
+	bool createDirectory(const std::string& path, bool* existed = nullptr);
+
+	/*! \brief Bytes per write, a multiple of the cluster size */
+	u32 chunkSize() const { return chunk; }
+
+	/*! \brief FAT cluster size of the SD card (bytes, 0 if unknown) */
+	u32 cluster() const { return clusterSize; }
+};
@@ -0,0 +1,117 @@
+#include "unicode.h"
+
+size_t utf16Length(const u16* str, const size_t maxLen) {
+	size_t len = 0;
+	while (len < maxLen && str[len] != 0) {
+		len++;
+	}
+	return len;
+}
+
+size_t utf16ToUtf8(char* dst, const u16* src, const size_t len) {
+	char* out = dst;
+	size_t i = 0;
+	while (i < len) {
+		// Fast path: four ASCII code units at once (all of them below 0x80)
+		while (i + 4 <= len) {
+			u64 word;
+			std::memcpy(&word, src + i, sizeof(word));
+			if ((word & 0xFF80FF80FF80FF80ULL) != 0) {
+				break;
+			}
+			out[0] = (char)src[i];
+			out[1] = (char)src[i + 1];
+			out[2] = (char)src[i + 2];
+			out[3] = (char)src[i + 3];
+			out += 4;
+			i += 4;
+		}
+		if (i >= len) {
+			break;
+		}
+
+		u32 c = src[i++];
+		if (c < 0x80) {
+			*out++ = (char)c;
+			continue;
+		}
+		if (c < 0x800) {
+			*out++ = (char)(0xC0 | (c >> 6));
+			*out++ = (char)(0x80 | (c & 0x3F));
+			continue;
+		}
+		if (c >= 0xD800 && c <= 0xDFFF) {
+			// Surrogate pair -> 4 bytes, anything else is malformed
+			if (c <= 0xDBFF && i < len && src[i] >= 0xDC00 && src[i] <= 0xDFFF) {
+				c = 0x10000 + ((c - 0xD800) << 10) + (src[i++] - 0xDC00);
+				*out++ = (char)(0xF0 | (c >> 18));
+				*out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+				*out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+				*out++ = (char)(0x80 | (c & 0x3F));
+				continue;
+			}
+			c = 0xFFFD;
+		}
+		*out++ = (char)(0xE0 | (c >> 12));
+		*out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+		*out++ = (char)(0x80 | (c & 0x3F));
+	}
+	return out - dst;
+}
+
+std::string utf16ToUtf8(const u16* src, const size_t len) {
+	std::string out(UTF8_MAX_SIZE(len), '\0');
+	out.resize(utf16ToUtf8(&out[0], src, len));
+	return out;
+}
+
+std::u16string utf8ToUtf16(const std::string& src) {
+	std::u16string out;
+	out.reserve(src.length());
+
+	const u8* s = (const u8*)src.data();
+	const size_t len = src.length();
+	size_t i = 0;
+	while (i < len) {
+		u32 c = s[i];
+		size_t extra;
+		u32 min;
+		if (c < 0x80) {
+			out += (char16_t)c;
+			i++;
+			continue;
+		} else if ((c & 0xE0) == 0xC0) {
+			extra = 1;
+			min = 0x80;
+			c &= 0x1F;
+		} else if ((c & 0xF0) == 0xE0) {
+			extra = 2;
+			min = 0x800;
+			c &= 0x0F;
+		} else if ((c & 0xF8) == 0xF0) {
+			extra = 3;
+			min = 0x10000;
+			c &= 0x07;
+		} else {
+			out += (char16_t)0xFFFD;
+			i++;
+			continue;
+		}
+
+		size_t j = 1;
+		for (; j <= extra && i + j < len && (s[i + j] & 0xC0) == 0x80; j++) {
+			c = (c << 6) | (s[i + j] & 0x3F);
+		}
+		i += j;
+		if (j <= extra || c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+			out += (char16_t)0xFFFD;
+		} else if (c >= 0x10000) {
+			c -= 0x10000;
+			out += (char16_t)(0xD800 + (c >> 10));
+			out += (char16_t)(0xDC00 + (c & 0x3FF));
+		} else {
+			out += (char16_t)c;
+		}
+	}
+	return out;
+}
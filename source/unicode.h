@@ -0,0 +1,45 @@
+#pragma once
+
+#include "libs.h"
+
+/*! \brief Worst case UTF-8 size (in bytes) of `len` UTF-16 code units */
+#define UTF8_MAX_SIZE(len) ((len) * 3)
+
+/*! \brief Length of a NUL-terminated UTF-16 string
+ *
+ *  \param str    UTF-16 string
+ *  \param maxLen Maximum number of code units to look at
+ *
+ *  \return Number of code units before the terminator (or maxLen)
+ */
+size_t utf16Length(const u16* str, const size_t maxLen);
+
+/*! \brief Converts UTF-16 (native endianness) to UTF-8
+ *  Runs of ASCII are converted several characters at a time. Unpaired surrogates
+ *  become U+FFFD. No terminator is written.
+ *
+ *  \param dst Output buffer, must hold at least UTF8_MAX_SIZE(len) bytes
+ *  \param src UTF-16 code units
+ *  \param len Number of code units to convert
+ *
+ *  \return Number of bytes written to dst
+ */
+size_t utf16ToUtf8(char* dst, const u16* src, const size_t len);
+
+/*! \brief Converts UTF-16 (native endianness) to a UTF-8 string
+ *
+ *  \param src UTF-16 code units
+ *  \param len Number of code units to convert
+ *
+ *  \return UTF-8 string
+ */
+std::string utf16ToUtf8(const u16* src, const size_t len);
+
+/*! \brief Converts a UTF-8 string to UTF-16 (native endianness)
+ *  Malformed sequences become U+FFFD.
+ *
+ *  \param src UTF-8 string
+ *
+ *  \return UTF-16 string, eg. for fsMakePath(PATH_UTF16, ...)
+ */
+std::u16string utf8ToUtf16(const std::string& src);
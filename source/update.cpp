@@ -1,115 +1,244 @@
 #include "update.h"
 
 #include "arnutil.h"
+#include "blocksync.h"
 #include "console.h"
+#include "deltaupdate.h"
+#include "digest.h"
 #include "lumautils.h"
+#include "patch.h"
+#include "pipeline.h"
+#include "sdwriter.h"
 #include "utils.h"
+#include "version.h"
 
-static inline bool pathchange(u8* buf, const size_t bufSize, const std::string& path) {
-	const static char original[] = "sdmc:/arm9loaderhax.bin";
-	const static size_t prefixSize = 12; // S \0 D \0 M \0 C \0 : \0 / \0
-	const static size_t originalSize = sizeof(original)/sizeof(char);
-	u8 pathLength = path.length();
+// Patches applied to the downloaded payload, all found in a single scan
+static std::vector<PatchRule> payloadPatches(const UpdateArgs& args) {
+	std::vector<PatchRule> rules;
 
-	if (pathLength > MAXPATHLEN) {
-		logPrintf("Cannot accept payload path: too long (max %d chars)\n", MAXPATHLEN);
+	// A9LH payloads chainload "sdmc:/arm9loaderhax.bin", point them to their actual path
+	if (args.payloadType == PayloadType::A9LH && args.payloadPath != std::string("/") + DEFAULT_A9LH_PATH) {
+		rules.push_back(PatchRule{
+			"payload path", "sdmc:/arm9loaderhax.bin", PatchEncoding::UTF16, true,
+			6, args.payloadPath, MAXPATHLEN, '\0', true
+		});
+	}
+
+	return rules;
+}
+
+// Chunks read ahead while earlier ones are hashed
+#define VERIFY_BUFFERS    3
+#define VERIFY_STACK_SIZE (16 * 1024)
+
+struct VerifyChunk {
+	u8* data = nullptr;
+	u32 size = 0; //!< 0 to stop the hasher
+};
+
+// Reads the saved payload back while a worker hashes it, the payload in memory is hashed
+// in the meantime. Only VERIFY_BUFFERS chunks are allocated, never a second copy.
+static bool verifyPayload(SdWriter& writer, const std::string& path, const ArchiveBuffer& payload) {
+	SdWriter::ReadHandle handle;
+	u64 fileSize = 0;
+	if (!writer.openRead(path, &handle, &fileSize)) {
+		logPrintf("Could not open %s\n", path.c_str());
+		return false;
+	}
+	if (fileSize != payload.size) {
+		logPrintf("Size mismatch (%llu on SD, %u expected)\n", (unsigned long long)fileSize, payload.size);
+		writer.closeRead(handle);
 		return false;
 	}
 
-	logPrintf("Searching for \"%s\" in payload...\n", original);
+	StageStats read, hash, reference;
+	read.name = "read";
+	hash.name = "hash";
+	reference.name = "memory";
+
+	Digest written, expected;
+	auto hashChunk = [&written, &hash](const VerifyChunk& chunk) {
+		const u64 start = svcGetSystemTick();
+		written.update(chunk.data, chunk.size);
+		hash.busyTicks += svcGetSystemTick() - start;
+		hash.bytes += chunk.size;
+	};
 
-	size_t curProposedOffset = 0;
-	u8 curStringIndex = 0;
-	bool found = false;
+	// Buffers go around: empty -> read into -> hashed -> empty
+	const u32 chunkSize = writer.chunkSize();
+	const u32 bufferSize = (u32)std::max<size_t>(std::min<size_t>(chunkSize, payload.size), 1);
+	std::vector<std::unique_ptr<u8[]>> buffers;
+	StageQueue<VerifyChunk, VERIFY_BUFFERS> filled;
+	StageQueue<u8*, VERIFY_BUFFERS> empty;
+
+	// If the hasher can't be created, chunks are hashed as they are read (one buffer is enough)
+	StageThread hasher;
+	hasher.start([&filled, &empty, &hash, &hashChunk]() {
+		for (VerifyChunk chunk = filled.pop(&hash); chunk.size > 0; chunk = filled.pop(&hash)) {
+			hashChunk(chunk);
+			empty.push(std::move(chunk.data));
+		}
+	}, VERIFY_STACK_SIZE);
+	const u32 bufferCount = hasher.running() ? VERIFY_BUFFERS : 1;
+	for (u32 i = 0; i < bufferCount; i++) {
+		buffers.emplace_back(new u8[bufferSize]);
+		empty.push(buffers.back().get());
+	}
 
-	// Byte-by-byte search. (memcmp might be faster?)
-	// Since "s" (1st char) is only used once in the whole string we can search in O(n)
-	for (size_t offset = 0; offset < bufSize-originalSize; ++offset) {
-		if (buf[offset] == original[curStringIndex] && buf[offset+1] == 0) {
-			if (curStringIndex == originalSize - 1) {
-				found = true;
-				break;
-			}
-			if (curStringIndex == 0) {
-				curProposedOffset = offset;
-			}
-			curStringIndex++;
-			offset++; // Skip one byte because Unicode
-			continue;
+	const u64 start = svcGetSystemTick();
+	bool ok = true;
+	for (size_t offset = 0; offset < payload.size; offset += chunkSize) {
+		VerifyChunk chunk;
+		chunk.data = empty.pop(&read);
+		chunk.size = (u32)std::min<size_t>(chunkSize, payload.size - offset);
+
+		const u64 readStart = svcGetSystemTick();
+		ok = writer.read(handle, offset, chunk.data, chunk.size);
+		read.busyTicks += svcGetSystemTick() - readStart;
+		read.bytes += chunk.size;
+		if (!ok) {
+			break;
 		}
 
-		if (curStringIndex > 0) {
-			curStringIndex = 0;
+		if (hasher.running()) {
+			filled.push(std::move(chunk), &read);
+		} else {
+			hashChunk(chunk);
+			empty.push(std::move(chunk.data));
 		}
+
+		const u64 referenceStart = svcGetSystemTick();
+		expected.update(payload.data + offset, chunk.size);
+		reference.busyTicks += svcGetSystemTick() - referenceStart;
+		reference.bytes += chunk.size;
+	}
+
+	if (hasher.running()) {
+		filled.push(VerifyChunk());
+		hasher.join();
 	}
+	writer.closeRead(handle);
 
-	// Not found?
-	if (!found) {
-		logPrintf("Could not find payload path, is this even a valid payload?\n");
+	if (!ok) {
+		logPrintf("Could not read %s back\n", path.c_str());
 		return false;
 	}
 
-	// Replace "arm9loaderhax.bin" with own payload path
-	size_t offset = curProposedOffset + prefixSize;
-	u8 i = 0;
-	for (i = 0; i < pathLength; ++i) {
-		buf[offset + i*2] = path[i];
-	};
-	// Replace remaining characters from original path with 0s
-	for (i = pathLength; i < originalSize; ++i) {
-		buf[offset + i*2] = 0;
+	const DigestResult writtenDigest = written.finish();
+	const DigestResult expectedDigest = expected.finish();
+	pipelinePrintStats({ read, hash, reference }, svcGetSystemTick() - start);
+	return writtenDigest.crc32 == expectedDigest.crc32 &&
+		std::memcmp(writtenDigest.sha256, expectedDigest.sha256, sizeof(expectedDigest.sha256)) == 0;
+}
+
+// Saves the payload in place of the installed one, and reads it back if asked to
+static UpdateResult savePayload(SdWriter& writer, const UpdateArgs& args, const ArchiveBuffer& payload) {
+	consoleScreen(GFX_TOP);
+	consoleSetProgressData("Saving payload to SD", 0.9);
+	consoleScreen(GFX_BOTTOM);
+
+	// The new payload is written next to the old one and renamed in place once complete.
+	// When it gets verified, the old one is only moved aside until that passes (even with
+	// backups off), so a bad write can always be undone. Then it becomes the backup (or
+	// gets removed).
+	const std::string backupPath = args.payloadPath + ".bak";
+	const std::string oldPath = args.payloadPath + PAYLOAD_OLD_SUFFIX;
+	logPrintf("Saving payload to SD (as %s)...\n", args.payloadPath.c_str());
+	if (!args.backupExisting) {
+		logPrintf("Payload backup is disabled in config, replacing old payload...\n");
 	}
+	gfxFlushBuffers();
+	const bool hadPayload = fileExists(args.payloadPath);
+	const std::string asidePath = args.verifyWrite ? oldPath : args.backupExisting ? backupPath : "";
+	if (!writer.replace(args.payloadPath, payload.data, payload.size, asidePath)) {
+		logPrintf("\nCould not install %s (!!), aborting...\n", args.payloadPath.c_str());
+		return { false, "INSTALL FAILED" };
+	}
+
+	if (args.verifyWrite) {
+		consoleScreen(GFX_TOP);
+		consoleSetProgressData("Verifying payload", 0.95);
+		consoleScreen(GFX_BOTTOM);
 
-	return true;
+		logPrintf("Reading back %s...\n", args.payloadPath.c_str());
+		gfxFlushBuffers();
+		if (!verifyPayload(writer, args.payloadPath, payload)) {
+			logPrintf("\nSaved payload doesn't match the downloaded one (!!)\n");
+			// The old payload is the one that was working until now
+			if (hadPayload) {
+				logPrintf("Restoring the previous payload...\n");
+				if (!writer.remove(args.payloadPath) || !writer.rename(oldPath, args.payloadPath)) {
+					logPrintf("Could not restore it, please rename %s to %s manually\n", oldPath.c_str(), args.payloadPath.c_str());
+				}
+			}
+			return { false, "VERIFY FAILED" };
+		}
+		logPrintf("Saved payload verified.\n");
+
+		if (hadPayload) {
+			bool kept = true;
+			if (args.backupExisting) {
+				writer.remove(backupPath);
+				kept = writer.rename(oldPath, backupPath);
+			} else {
+				kept = writer.remove(oldPath);
+			}
+			if (!kept) {
+				logPrintf("WARN\nCould not %s %s\n\n", args.backupExisting ? "make a backup out of" : "remove", oldPath.c_str());
+			}
+		}
+	}
+	return { true, "NO ERROR" };
 }
 
-static inline bool backupA9LH(const std::string& payloadName) {
-	std::ifstream original(payloadName, std::ifstream::binary);
-	if (!original.good()) {
-		logPrintf("Could not open %s\n", payloadName.c_str());
-		return false;
+bool recoverPayload(const std::string& payloadPath) {
+	const std::string partialName = payloadPath + SD_PARTIAL_SUFFIX;
+	const std::string tempName = payloadPath + SD_TEMP_SUFFIX;
+	bool ok = true;
+
+	if (fileExists(partialName)) {
+		logPrintf("Removing partial payload from an interrupted update...\n");
+		ok = std::remove(partialName.c_str()) == 0;
 	}
 
-	std::string backupName = payloadName + ".bak";
-	std::ofstream target(backupName, std::ofstream::binary);
-	if (!target.good()) {
-		logPrintf("Could not open %s\n", backupName.c_str());
-		original.close();
-		return false;
+	// The update stopped before the new payload was verified, the old one is the last one
+	// known to work: put it back
+	const std::string oldName = payloadPath + PAYLOAD_OLD_SUFFIX;
+	if (fileExists(oldName)) {
+		logPrintf("Restoring the payload replaced by an unverified update...\n");
+		if (fileExists(tempName)) {
+			std::remove(tempName.c_str());
+		}
+		if (fileExists(payloadPath) && std::remove(payloadPath.c_str()) != 0) {
+			return false;
+		}
+		return std::rename(oldName.c_str(), payloadPath.c_str()) == 0 && ok;
 	}
 
-	target << original.rdbuf();
+	if (!fileExists(tempName)) {
+		return ok;
+	}
+
+	// The temp file is complete: with the payload gone, the update stopped right before
+	// renaming it in place. Otherwise the old payload was never touched, keep it.
+	if (!fileExists(payloadPath)) {
+		logPrintf("Found complete payload from an interrupted update, installing it...\n");
+		return std::rename(tempName.c_str(), payloadPath.c_str()) == 0 && ok;
+	}
 
-	original.close();
-	target.close();
-	return true;
+	logPrintf("Removing payload from an interrupted update...\n");
+	return std::remove(tempName.c_str()) == 0 && ok;
 }
 
 UpdateResult update(const UpdateArgs& args) {
+	versionCacheInvalidate();
+
 	consoleScreen(GFX_TOP);
 	consoleInitProgress("Updating Luma3DS", "Performing preliminary operations", 0);
 
 	consoleScreen(GFX_BOTTOM);
 	consoleClear();
 
-	// Back up local file if it exists
-	if (!args.backupExisting) {
-		logPrintf("Payload backup is disabled in config, skipping...\n");
-	} else if (!fileExists(args.payloadPath)) {
-		logPrintf("Original payload not found, skipping backup...\n");
-	} else {
-		consoleScreen(GFX_TOP);
-		consoleSetProgressData("Backing up old payload", 0.1);
-		consoleScreen(GFX_BOTTOM);
-
-		logPrintf("Copying %s to %s.bak...\n", args.payloadPath.c_str(), args.payloadPath.c_str());
-		gfxFlushBuffers();
-		if (!backupA9LH(args.payloadPath)) {
-			logPrintf("\nCould not backup %s (!!), aborting...\n", args.payloadPath.c_str());
-			return { false, "BACKUP FAILED" };
-		}
-	}
-
 	consoleScreen(GFX_TOP);
 	consoleSetProgressData("Downloading payload", 0.3);
 	consoleScreen(GFX_BOTTOM);
@@ -117,24 +246,39 @@ UpdateResult update(const UpdateArgs& args) {
 	logPrintf("Downloading %s\n", args.chosenVersion.url.c_str());
 	gfxFlushBuffers();
 
-	u8* payloadData = nullptr;
-	size_t offset = 0;
-	size_t payloadSize = 0;
-	if (!releaseGetPayload(args.payloadType, args.chosenVersion, args.isHourly, &payloadData, &offset, &payloadSize)) {
+	// A patch against the installed payload is usually a tiny fraction of the release archive
+	ArchiveBuffer payload;
+	bool patched = false;
+	bool triedPatching = false;
+	if (!args.deltaManifest.empty() && !args.installAll) {
+		logPrintf("Looking for a patch to %s...\n", args.chosenVersion.filename.c_str());
+		patched = deltaGetPayload(args.deltaManifest, args.chosenVersion, releasePayloadPath(args.payloadType), args.payloadPath, &payload);
+		triedPatching = true;
+	}
+	// Mirrors without patches can still send only the blocks that changed
+	if (!patched && !args.syncMirror.empty() && !args.installAll) {
+		logPrintf("Syncing %s from %s...\n", args.chosenVersion.filename.c_str(), args.syncMirror.c_str());
+		patched = blockSyncGetPayload(args.syncMirror, args.chosenVersion, releasePayloadPath(args.payloadType), args.payloadPath, &payload);
+		triedPatching = true;
+	}
+	if (triedPatching && !patched) {
+		logPrintf("Downloading the whole release instead\n");
+	}
+	ReleaseArchive fullRelease;
+	if (!patched && !releaseGetPayload(args.payloadType, args.chosenVersion, args.isHourly, args.cachePayloads, &payload, args.installAll ? &fullRelease : nullptr)) {
 		logPrintf("FATAL\nCould not get A9LH payload...\n");
-		std::free(payloadData);
 		return { false, "DOWNLOAD FAILED" };
 	}
 
-	if (args.payloadType == PayloadType::A9LH && args.payloadPath != std::string("/") + DEFAULT_A9LH_PATH) {
+	std::vector<PatchRule> patches = payloadPatches(args);
+	if (!patches.empty()) {
 		consoleScreen(GFX_TOP);
-		consoleSetProgressData("Applying path changing", 0.6);
+		consoleSetProgressData("Patching payload", 0.6);
 		consoleScreen(GFX_BOTTOM);
 
-		logPrintf("Requested payload path is not %s, applying path patch...\n", DEFAULT_A9LH_PATH);
-		if (!pathchange(payloadData + offset, payloadSize, args.payloadPath)) {
-			std::free(payloadData);
-			return { false, "PATHCHANGE FAILED" };
+		logPrintf("Applying %u payload patch(es)...\n", (unsigned int)patches.size());
+		if (!PatchSet(patches).apply(payload.data, payload.size)) {
+			return { false, "PATCHING FAILED" };
 		}
 	}
 
@@ -155,24 +299,54 @@ UpdateResult update(const UpdateArgs& args) {
 	}
 
 	consoleScreen(GFX_TOP);
-	consoleSetProgressData("Saving payload to SD", 0.9);
+	consoleSetProgressData("Comparing with installed payload", 0.85);
 	consoleScreen(GFX_BOTTOM);
 
-	logPrintf("Saving payload to SD (as %s)...\n", args.payloadPath.c_str());
-	std::ofstream a9lhfile("/" + args.payloadPath, std::ofstream::binary);
-	a9lhfile.write((const char*)(payloadData + offset), payloadSize);
-	a9lhfile.close();
+	bool unchanged = false;
+	try {
+		SdWriter writer;
+
+		// Re-installing the same version would only wear the SD and replace a good backup
+		logPrintf("Comparing with %s...\n", args.payloadPath.c_str());
+		gfxFlushBuffers();
+		unchanged = writer.identical(args.payloadPath, payload.data, payload.size);
+		if (unchanged) {
+			logPrintf("Installed payload is identical, skipping backup and write.\n");
+		} else {
+			const UpdateResult saved = savePayload(writer, args, payload);
+			if (!saved.success) {
+				return saved;
+			}
+		}
+	} catch (const std::runtime_error& e) {
+		logPrintf("\nFATAL: %s\n", e.what());
+		return { false, "INSTALL FAILED" };
+	}
+
+	// Only once the payload is in place, so a failed payload install leaves every other file
+	// as it was
+	if (fullRelease.archive) {
+		consoleScreen(GFX_TOP);
+		consoleSetProgressData("Installing other files", 0.97);
+		consoleScreen(GFX_BOTTOM);
+
+		if (!releaseInstallAll(fullRelease)) {
+			return { false, "INSTALL FAILED" };
+		}
+		unchanged = false;
+	}
 
 	logPrintf("All done, freeing resources and exiting...\n");
-	std::free(payloadData);
 
 	consoleClear();
 	consoleScreen(GFX_TOP);
 
-	return { true, "NO ERROR" };
+	return { true, "NO ERROR", unchanged };
 }
 
 UpdateResult restore(const UpdateArgs& args) {
+	versionCacheInvalidate();
+
 	// Rename current payload to .broken
 	if (std::rename(args.payloadPath.c_str(), (args.payloadPath + ".broken").c_str()) != 0) {
 		logPrintf("Can't rename current version");
@@ -6,6 +6,9 @@
 
 #define MAXPATHLEN 37
 
+// Old payload kept aside until the new one is verified (see UpdateArgs::verifyWrite)
+#define PAYLOAD_OLD_SUFFIX ".old"
+
 struct UpdateArgs {
 	PayloadType  payloadType;    /*!< Type of payload to upgrade  */
 	std::string  payloadPath;    /*!< Path to Luma3DS payload     */
@@ -13,12 +16,29 @@ struct UpdateArgs {
 	bool         migrateARN;     /*!< Migrate from AuReiNand      */
 	ReleaseVer   chosenVersion;  /*!< Version to update to        */
 	bool         isHourly;       /*!< Is chosen version a hourly? */
+	bool         cachePayloads;  /*!< Keep decoded payloads on SD */
+	bool         installAll;     /*!< Extract the whole release   */
+	bool         verifyWrite;    /*!< Read back the saved payload */
+	std::string  deltaManifest;  /*!< Patch manifest URL (or "") */
+	std::string  syncMirror;     /*!< Block sync mirror (or "")  */
 };
 
 struct UpdateResult {
-	bool        success; /*!< Wether the operation was a success */
-	std::string errcode; /*!< Error code if success is false     */
+	bool        success;   /*!< Wether the operation was a success             */
+	std::string errcode;   /*!< Error code if success is false                 */
+	bool        unchanged; /*!< Payload was already installed, nothing written */
+
+	UpdateResult(const bool success = false, const std::string& errcode = "", const bool unchanged = false)
+		: success(success), errcode(errcode), unchanged(unchanged) {}
 };
 
 UpdateResult update(const UpdateArgs& args);
+
+/*! \brief Finishes or cleans up after an update that was interrupted while saving the payload
+ *
+ *  \param payloadPath Path to Luma3DS payload
+ *
+ *  \return true if there was nothing to do or the leftovers were handled, false otherwise
+ */
+bool recoverPayload(const std::string& payloadPath);
 UpdateResult restore(const UpdateArgs& args);
\ No newline at end of file
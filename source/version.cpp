@@ -2,6 +2,17 @@
 
 #include "utils.h"
 
+#include <sys/stat.h>
+
+#if defined(__linux__) && !defined(_3DS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// libmd5-rfc includes
+#include "md5/md5.h"
+
 const std::string LumaVersion::toString(bool printBranch) const {
 	std::string currentVersionStr = release;
 	if (!commit.empty()) {
@@ -13,6 +24,8 @@ const std::string LumaVersion::toString(bool printBranch) const {
 	return currentVersionStr;
 }
 
+#ifdef _3DS
+
 /* Luma3DS 0x2e svc version struct */
 struct PACKED SvcLumaVersion {
 	char magic[4];
@@ -60,65 +73,142 @@ LumaVersion versionSvc() {
 	return version;
 }
 
-LumaVersion versionMemsearch(const std::string& path) {
-	const static char searchString[] = "Luma3DS v";
-	const static size_t searchStringLen = sizeof(searchString)/sizeof(char) - 1;
+#else
 
-	std::ifstream payloadFile(path, std::ios::binary | std::ios::ate);
-	if (!payloadFile) {
-		logPrintf("Could not open existing payload, does it exists?\n");
-		return LumaVersion{};
+// Host builds (tools/) have no Luma3DS to ask
+LumaVersion versionSvc() {
+	return LumaVersion{};
+}
+
+#endif
+
+// Files are read this much at a time when looking for the version string
+#define VERSION_CHUNK_SIZE (32 * 1024)
+// Longest version string accepted after the marker (eg. "6.6-12ab34cd (dev)")
+#define VERSION_MAX_LENGTH 64
+
+// Finds the first occurrence of needle, candidates are located with memchr on its first byte
+static const char* memsearch(const char* data, const size_t size, const char* needle, const size_t needleLen) {
+	const char* cur = data;
+	const char* end = data + size;
+	while ((size_t)(end - cur) >= needleLen) {
+		cur = (const char*)std::memchr(cur, needle[0], end - cur - needleLen + 1);
+		if (cur == nullptr) {
+			return nullptr;
+		}
+		if (std::memcmp(cur + 1, needle + 1, needleLen - 1) == 0) {
+			return cur;
+		}
+		++cur;
 	}
+	return nullptr;
+}
 
-	/* Load entire file into local buffer */
-	size_t payloadSize = payloadFile.tellg();
-	payloadFile.seekg(0, std::ios::beg);
-	char* payloadData = (char*)std::malloc(payloadSize);
-	payloadFile.read(payloadData, payloadSize);
-	payloadFile.close();
+// Version is what comes after the marker and before " configuration" (or the end of the string)
+static std::string versionExtract(const char* data, const size_t size) {
+	size_t len = 0;
+	for (; len < size; ++len) {
+		if (data[len] == '\0' || (data[len] == 'c' && len > 0 && data[len-1] == ' ')) {
+			break;
+		}
+	}
+	if (len > 0 && data[len-1] == ' ') {
+		--len;
+	}
+	return std::string(data, len);
+}
 
-	logPrintf("Loaded existing payload in memory, searching for version number...\n");
+static const char searchString[] = "Luma3DS v";
+static const size_t searchStringLen = sizeof(searchString)/sizeof(char) - 1;
 
-	size_t curProposedOffset = 0;
-	unsigned short curStringIndex = 0;
-	bool found = false;
-	std::string versionString = "";
+#if defined(__linux__) && !defined(_3DS)
 
-	// Byte-by-byte search. (memcmp might be faster?)
-	// Since " " (1st char) is only used once in the whole string we can search in O(n)
-	for (size_t offset = 0; offset < payloadSize - searchStringLen; ++offset) {
-		if (payloadData[offset] == searchString[curStringIndex]) {
-			if (curStringIndex == searchStringLen - 1) {
-				found = true;
-				break;
-			}
-			if (curStringIndex == 0) {
-				curProposedOffset = offset;
-			}
-			curStringIndex++;
+// Host builds map the payload instead of reading it
+static bool versionFind(const std::string& path, std::string& versionString) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return false;
+	}
+	// An empty payload exists but holds no version, and can't be mapped
+	if (info.st_size == 0) {
+		close(fd);
+		return true;
+	}
+	const size_t size = info.st_size;
+	void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	const char* data = (const char*)map;
+	const char* found = memsearch(data, size, searchString, searchStringLen);
+	if (found != nullptr) {
+		const char* version = found + searchStringLen;
+		versionString = versionExtract(version, std::min<size_t>(VERSION_MAX_LENGTH, data + size - version));
+	}
+	munmap(map, size);
+	return true;
+}
+
+#else
+
+// The payload is read sequentially in chunks, the tail of each chunk is carried over
+// so that a marker (and the version following it) split between two reads is still found
+static bool versionFind(const std::string& path, std::string& versionString) {
+	std::ifstream payloadFile(path, std::ios::binary);
+	if (!payloadFile) {
+		return false;
+	}
+
+	const size_t carrySize = searchStringLen + VERSION_MAX_LENGTH;
+	std::vector<char> buffer(carrySize + VERSION_CHUNK_SIZE);
+	size_t carried = 0;
+	const char* found = nullptr;
+	size_t available = 0;
+
+	while (payloadFile) {
+		payloadFile.read(buffer.data() + carried, VERSION_CHUNK_SIZE);
+		available = carried + payloadFile.gcount();
+		if (available == carried) {
+			break;
 		}
-		else {
-			if (curStringIndex > 0) {
-				curStringIndex = 0;
-			}
+
+		found = memsearch(buffer.data(), available, searchString, searchStringLen);
+		if (found != nullptr) {
+			break;
 		}
+
+		carried = std::min(available, searchStringLen - 1);
+		std::memmove(buffer.data(), buffer.data() + available - carried, carried);
 	}
 
-	if (found) {
-		// Version is what comes after " v" and before " configuration"
-		curProposedOffset += searchStringLen;
-		size_t verOffset = curProposedOffset;
-		for (; verOffset < payloadSize; ++verOffset) {
-			if (payloadData[verOffset] == 'c' && payloadData[verOffset-1] == ' ') {
-				break;
-			}
+	if (found != nullptr) {
+		// Make sure the version itself is in the buffer, it might start right at the end of the chunk
+		size_t offset = found - buffer.data();
+		if (offset + carrySize > available && payloadFile) {
+			std::memmove(buffer.data(), buffer.data() + offset, available - offset);
+			available -= offset;
+			offset = 0;
+			payloadFile.read(buffer.data() + available, carrySize - available);
+			available += payloadFile.gcount();
 		}
-		// Get full version string
-		versionString = std::string(payloadData + curProposedOffset, verOffset - curProposedOffset - 1);
+		const size_t version = offset + searchStringLen;
+		versionString = versionExtract(buffer.data() + version, std::min<size_t>(VERSION_MAX_LENGTH, available - version));
 	}
 
-	std::free(payloadData);
+	return true;
+}
+
+#endif
 
+static LumaVersion versionParse(const std::string& versionString) {
 	const size_t separator = versionString.find("-");
 	if (separator == std::string::npos) {
 		return LumaVersion{ versionString, "", false };
@@ -137,4 +227,135 @@ LumaVersion versionMemsearch(const std::string& path) {
 	}
 
 	return version;
-}
\ No newline at end of file
+}
+LumaVersion versionMemsearch(const std::string& path) {
+	std::string versionString = "";
+	if (!versionFind(path, versionString)) {
+		logPrintf("Could not open existing payload, does it exists?\n");
+		return LumaVersion{};
+	}
+	return versionParse(versionString);
+}
+
+// Bytes hashed at each end of a payload to tell it apart from another one of the same size
+#define VERSION_SAMPLE_SIZE 4096
+
+/* Identity of a payload file on SD */
+struct VersionKey {
+	u64         size;
+	u64         mtime;
+	std::string hash; // MD5 of the first and last VERSION_SAMPLE_SIZE bytes
+};
+
+static bool versionKey(const std::string& path, VersionKey& key) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return false;
+	}
+	key.size = info.st_size;
+#ifdef _3DS
+	// stat() doesn't report times for the SD card
+	if (sdmc_getmtime(path.c_str(), &key.mtime) != 0) {
+		key.mtime = 0;
+	}
+#else
+	key.mtime = info.st_mtime;
+#endif
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	const size_t headSize = std::min<u64>(key.size, VERSION_SAMPLE_SIZE);
+	const size_t tailSize = std::min<u64>(key.size - headSize, VERSION_SAMPLE_SIZE);
+	std::vector<char> sample(headSize + tailSize);
+	file.read(sample.data(), headSize);
+	if (tailSize > 0) {
+		file.seekg(key.size - tailSize, std::ios::beg);
+		file.read(sample.data() + headSize, tailSize);
+	}
+	if (!file) {
+		return false;
+	}
+
+	md5_state_t state;
+	md5_byte_t result[16];
+	md5_init(&state);
+	md5_append(&state, (const md5_byte_t *)sample.data(), sample.size());
+	md5_finish(&state, result);
+
+	static const char hexdigits[] = "0123456789abcdef";
+	key.hash.assign(32, '0');
+	for (u8 i = 0; i < 16; i++) {
+		key.hash[i * 2] = hexdigits[result[i] >> 4];
+		key.hash[i * 2 + 1] = hexdigits[result[i] & 0xf];
+	}
+	return true;
+}
+
+/* Cache lines are "<path>\t<size>\t<mtime>\t<hash>\t<version string>" */
+struct VersionCacheEntry {
+	std::string path;
+	VersionKey  key;
+	std::string version;
+};
+
+static std::vector<VersionCacheEntry> versionCacheLoad() {
+	std::vector<VersionCacheEntry> entries;
+	std::ifstream cache(VERSION_CACHE_PATH);
+	std::string line;
+	while (std::getline(cache, line)) {
+		std::stringstream fields(line);
+		VersionCacheEntry entry;
+		std::string size, mtime;
+		if (std::getline(fields, entry.path, '\t') && std::getline(fields, size, '\t') &&
+			std::getline(fields, mtime, '\t') && std::getline(fields, entry.key.hash, '\t')) {
+			std::getline(fields, entry.version);
+			entry.key.size = std::strtoull(size.c_str(), nullptr, 10);
+			entry.key.mtime = std::strtoull(mtime.c_str(), nullptr, 10);
+			entries.push_back(entry);
+		}
+	}
+	return entries;
+}
+
+LumaVersion versionDetect(const std::string& path) {
+	VersionKey key;
+	if (!versionKey(path, key)) {
+		return versionMemsearch(path);
+	}
+
+	std::vector<VersionCacheEntry> entries = versionCacheLoad();
+	for (const VersionCacheEntry& entry : entries) {
+		if (entry.path == path && entry.key.size == key.size && entry.key.mtime == key.mtime && entry.key.hash == key.hash) {
+			logPrintf("Using cached version for %s\n", path.c_str());
+			return versionParse(entry.version);
+		}
+	}
+
+	std::string versionString = "";
+	if (!versionFind(path, versionString)) {
+		logPrintf("Could not open existing payload, does it exists?\n");
+		return LumaVersion{};
+	}
+
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&path](const VersionCacheEntry& entry) {
+		return entry.path == path;
+	}), entries.end());
+	entries.push_back(VersionCacheEntry{ path, key, versionString });
+
+	std::ofstream cache(VERSION_CACHE_PATH);
+	for (const VersionCacheEntry& entry : entries) {
+		cache << entry.path << '\t' << entry.key.size << '\t' << entry.key.mtime << '\t' << entry.key.hash << '\t' << entry.version << '\n';
+	}
+	cache.close();
+	if (!cache) {
+		logPrintf("WARN: Could not save version cache\n");
+	}
+
+	return versionParse(versionString);
+}
+
+void versionCacheInvalidate() {
+	std::remove(VERSION_CACHE_PATH);
+}
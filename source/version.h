@@ -2,6 +2,8 @@
 
 #include "libs.h"
 
+#define VERSION_CACHE_PATH "/luma/lumaupdater-versions"
+
 /*! \brief Version data
  */
 struct LumaVersion {
@@ -25,4 +27,19 @@ LumaVersion versionSvc();
  *
  *  \return LumaVersion struct containing all the information that could be found
  */
-LumaVersion versionMemsearch(const std::string& path);
\ No newline at end of file
+LumaVersion versionMemsearch(const std::string& path);
+
+/*! \brief Same as versionMemsearch, but remembers the result on SD
+ *
+ *  Payloads are recognized by size, modification time and a hash of their first and last
+ *  few KiB, an unchanged payload costs a stat and two small reads instead of a full scan.
+ *
+ *  \param path Path to existing payload
+ *
+ *  \return LumaVersion struct containing all the information that could be found
+ */
+LumaVersion versionDetect(const std::string& path);
+
+/*! \brief Forgets every cached payload version, call after touching payloads on SD
+ */
+void versionCacheInvalidate();
\ No newline at end of file
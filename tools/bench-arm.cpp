@@ -0,0 +1,102 @@
+// lumaupdate-bench-arm: undoes the ARM branch filter (Bra.c) on payloads with the
+// word-at-a-time ARM_Convert and with the byte loop it replaced, checks both give back the
+// original payload and compares their speed.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "7z/Bra.h"
+
+// What ARM_Convert used to do: assemble and patch every BL byte by byte
+static SizeT armConvertBytes(Byte* data, SizeT size, UInt32 ip, const int encoding) {
+	SizeT i;
+	if (size < 4) {
+		return 0;
+	}
+	size -= 4;
+	ip += 8;
+	for (i = 0; i <= size; i += 4) {
+		if (data[i + 3] == 0xEB) {
+			UInt32 dest;
+			UInt32 src = ((UInt32)data[i + 2] << 16) | ((UInt32)data[i + 1] << 8) | (data[i + 0]);
+			src <<= 2;
+			if (encoding) {
+				dest = ip + (UInt32)i + src;
+			} else {
+				dest = src - (ip + (UInt32)i);
+			}
+			dest >>= 2;
+			data[i + 2] = (Byte)(dest >> 16);
+			data[i + 1] = (Byte)(dest >> 8);
+			data[i + 0] = (Byte)dest;
+		}
+	}
+	return i;
+}
+
+typedef SizeT (*ConvertFunc)(Byte* data, SizeT size, UInt32 ip, int encoding);
+
+// Best time to decode the filtered payload, the result is left in `out`
+static double timeDecode(const ConvertFunc convert, const std::vector<u8>& filtered, std::vector<u8>& out, const int rounds) {
+	double best = 0;
+	for (int r = 0; r < rounds; ++r) {
+		out = filtered;
+		const Clock::time_point start = Clock::now();
+		convert(out.data(), out.size(), 0, 0);
+		const double ms = elapsedMs(start);
+		best = r == 0 ? ms : std::min(best, ms);
+	}
+	return best;
+}
+
+int main(int argc, char* argv[]) {
+	int rounds = 200;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			rounds = std::max(std::atoi(argv[++i]), 1);
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.empty()) {
+		std::fprintf(stderr, "Usage: %s [-r rounds, default 200] <payload>...\n", argv[0]);
+		return 2;
+	}
+
+	std::printf("Best of %d rounds, MB/s\n", rounds);
+	std::printf("%10s %8s %10s %10s %8s  payload\n", "size", "BL", "bytes", "words", "gain");
+
+	bool ok = true;
+	for (const char* path : paths) {
+		std::vector<u8> payload;
+		if (!readFile(path, &payload)) {
+			std::fprintf(stderr, "Could not read %s\n", path);
+			ok = false;
+			continue;
+		}
+
+		// What an ARM-filtered archive holds, both loops must turn it back into the payload
+		std::vector<u8> filtered = payload;
+		armConvertBytes(filtered.data(), filtered.size(), 0, 1);
+
+		size_t branches = 0;
+		for (size_t i = 3; i < payload.size(); i += 4) {
+			branches += payload[i] == 0xEB;
+		}
+
+		// Vector data is allocated aligned, so ARM_Convert takes its word loop
+		std::vector<u8> bytesOut, wordsOut;
+		const double bytesMs = timeDecode(armConvertBytes, filtered, bytesOut, rounds);
+		const double wordsMs = timeDecode(ARM_Convert, filtered, wordsOut, rounds);
+		const double bytesMBs = bytesMs > 0 ? payload.size() / (bytesMs * 1000.0) : 0;
+		const double wordsMBs = wordsMs > 0 ? payload.size() / (wordsMs * 1000.0) : 0;
+
+		const bool same = bytesOut == payload && wordsOut == payload;
+		std::printf("%10zu %8zu %10.1f %10.1f %7.1f%%  %s%s\n", payload.size(), branches, bytesMBs, wordsMBs,
+			bytesMBs > 0 ? 100.0 * (wordsMBs / bytesMBs - 1) : 0.0, path, same ? "" : "  DIFFERENT OUTPUT");
+		ok = ok && same;
+	}
+	return ok ? 0 : 1;
+}
\ No newline at end of file
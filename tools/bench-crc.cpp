@@ -0,0 +1,109 @@
+// lumaupdate-bench-crc: times every CRC32 kernel this machine can run (7zCrc.c, 7zCrcOpt.c)
+// over blocks from 64 B to 8 MiB, and checks each of them against the byte-wise CrcUpdateT1.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "7z/7zCrc.h"
+#include "7z/CpuArch.h"
+
+typedef UInt32 (MY_FAST_CALL *CRC_FUNC)(UInt32 v, const void *data, size_t size, const UInt32 *table);
+
+extern "C" {
+UInt32 MY_FAST_CALL CrcUpdateT1(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#ifdef MY_CPU_LE
+UInt32 MY_FAST_CALL CrcUpdateT4(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#endif
+// Same condition as CRC_NUM_TABLES in 7zCrc.c
+#if defined(MY_CPU_LE) && (defined(MY_CPU_X86_OR_AMD64) || defined(MY_CPU_ARM64))
+UInt32 MY_FAST_CALL CrcUpdateT16(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#endif
+CRC_FUNC CrcGetHwKernel(void);
+}
+
+#define BENCH_MIN_SIZE 64
+#define BENCH_MAX_SIZE (8 * 1024 * 1024)
+
+static volatile UInt32 sink;
+
+struct Kernel {
+	const char* name;
+	CRC_FUNC    update;
+};
+
+// Every kernel must agree with the byte-wise one, at every size and alignment
+static bool check(const Kernel& kernel, const u8* data, const size_t size) {
+	for (size_t offset = 0; offset < 8; ++offset) {
+		const UInt32 expected = CrcUpdateT1(CRC_INIT_VAL, data + offset, size - offset, g_CrcTable);
+		if (kernel.update(CRC_INIT_VAL, data + offset, size - offset, g_CrcTable) != expected) {
+			std::fprintf(stderr, "%s: wrong CRC for %zu bytes at offset %zu\n", kernel.name, size - offset, offset);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	// Bytes hashed per kernel and block size, so small blocks are timed over many calls
+	const size_t total = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64) * 1024 * 1024;
+	if (total == 0) {
+		std::fprintf(stderr, "Usage: %s [MiB per block size, default 64]\n", argv[0]);
+		return 2;
+	}
+
+	std::vector<Kernel> kernels = { { "T1", CrcUpdateT1 } };
+#ifdef MY_CPU_LE
+	kernels.push_back({ "T4", CrcUpdateT4 });
+#endif
+#if defined(MY_CPU_LE) && (defined(MY_CPU_X86_OR_AMD64) || defined(MY_CPU_ARM64))
+	kernels.push_back({ "T16", CrcUpdateT16 });
+#endif
+	if (CRC_FUNC hw = CrcGetHwKernel()) {
+		kernels.push_back({ "hardware", hw });
+	}
+
+	std::vector<u8> data(BENCH_MAX_SIZE);
+	u32 seed = 1;
+	for (u8& byte : data) {
+		seed = seed * 1103515245 + 12345;
+		byte = (u8)(seed >> 16);
+	}
+
+	std::printf("%zu MiB per block size, MB/s\n%10s", total / (1024 * 1024), "block");
+	for (const Kernel& kernel : kernels) {
+		std::printf("%10s", kernel.name);
+	}
+	std::printf("\n");
+
+	bool ok = true;
+	for (size_t size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 2) {
+		if (size >= 1024 * 1024) {
+			std::printf("%6zu MiB", size / (1024 * 1024));
+		} else if (size >= 1024) {
+			std::printf("%6zu KiB", size / 1024);
+		} else {
+			std::printf("%8zu B", size);
+		}
+
+		const size_t rounds = std::max<size_t>(total / size, 1);
+		for (const Kernel& kernel : kernels) {
+			if (!check(kernel, data.data(), size)) {
+				ok = false;
+				std::printf("%10s", "WRONG");
+				continue;
+			}
+			// Feed the result back in so calls can't be dropped or overlapped
+			UInt32 crc = CRC_INIT_VAL;
+			const Clock::time_point start = Clock::now();
+			for (size_t r = 0; r < rounds; ++r) {
+				crc = kernel.update(crc, data.data(), size, g_CrcTable);
+			}
+			const double ms = elapsedMs(start);
+			sink = crc;
+			std::printf("%10.1f", rounds * size / (ms * 1000.0));
+		}
+		std::printf("\n");
+	}
+	return ok ? 0 : 1;
+}
\ No newline at end of file
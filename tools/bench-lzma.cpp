@@ -0,0 +1,101 @@
+// lumaupdate-bench-lzma: decodes every entry of release archives with the LZMA main loops
+// specialized for common lc/lp/pb (LzmaDec.c) and with the generic one, checks that both
+// give the same files and compares their speed.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "archive.h"
+#include "7z/LzmaDec.h"
+
+// Decodes the whole archive from scratch (so no block is reused), returns the time spent
+// extracting and the CRC of every file
+static double decodeAll(const std::vector<u8>& data, std::vector<u32>* crcs) {
+	std::unique_ptr<Archive> archive = Archive::open(data.data(), data.size());
+	std::vector<ArchiveEntry> entries = archive->entries();
+	crcs->clear();
+	double ms = 0;
+	for (const ArchiveEntry& e : entries) {
+		if (e.isDir) {
+			continue;
+		}
+		const Clock::time_point start = Clock::now();
+		ArchiveBuffer file = archive->extractFile(e.name);
+		ms += elapsedMs(start);
+		crcs->push_back(CrcCalc(file.data, file.size));
+	}
+	return ms;
+}
+
+int main(int argc, char* argv[]) {
+	int rounds = 10;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			rounds = std::max(std::atoi(argv[++i]), 1);
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.empty()) {
+		std::fprintf(stderr, "Usage: %s [-r rounds, default 10] <archive.7z>...\n", argv[0]);
+		return 2;
+	}
+
+	std::printf("Best of %d rounds, MB/s of unpacked data\n", rounds);
+	std::printf("%10s %12s %12s %8s  %-24s archive\n", "unpacked", "specialized", "generic", "gain", "coders");
+
+	bool ok = true;
+	for (const char* path : paths) {
+		std::vector<u8> data;
+		if (!readFile(path, &data)) {
+			std::fprintf(stderr, "Could not read %s\n", path);
+			ok = false;
+			continue;
+		}
+
+		try {
+			std::unique_ptr<Archive> archive = Archive::open(data.data(), data.size());
+			size_t unpacked = 0;
+			std::string coders;
+			for (const ArchiveBlock& b : archive->blocks()) {
+				unpacked += b.unpackedSize;
+				if (coders.find(b.coders) == std::string::npos) {
+					coders += (coders.empty() ? "" : ", ") + b.coders;
+				}
+			}
+			archive.reset();
+			if (coders.find("LZMA") == std::string::npos) {
+				std::printf("%10zu %12s %12s %8s  %-24s %s\n", unpacked, "-", "-", "", coders.c_str(), path);
+				continue;
+			}
+
+			double best[2] = { 0, 0 };
+			std::vector<u32> crcs[2];
+			for (int r = 0; r < rounds; ++r) {
+				// Alternate the two loops so both see the same machine state
+				for (int generic = 0; generic < 2; ++generic) {
+					g_LzmaDec_ForceGeneric = generic;
+					const double ms = decodeAll(data, &crcs[generic]);
+					best[generic] = r == 0 ? ms : std::min(best[generic], ms);
+				}
+			}
+			g_LzmaDec_ForceGeneric = 0;
+
+			const double mbs[2] = {
+				best[0] > 0 ? unpacked / (best[0] * 1000.0) : 0,
+				best[1] > 0 ? unpacked / (best[1] * 1000.0) : 0,
+			};
+			const bool same = crcs[0] == crcs[1];
+			std::printf("%10zu %12.2f %12.2f %7.1f%%  %-24s %s%s\n", unpacked, mbs[0], mbs[1],
+				mbs[1] > 0 ? 100.0 * (mbs[0] / mbs[1] - 1) : 0.0, coders.c_str(), path, same ? "" : "  DIFFERENT OUTPUT");
+			ok = ok && same;
+		} catch (const std::runtime_error& e) {
+			g_LzmaDec_ForceGeneric = 0;
+			std::fprintf(stderr, "%s: %s\n", path, e.what());
+			ok = false;
+		}
+	}
+	return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+// lumaupdate-bench-names: times UTF-16 -> UTF-8 name conversion and the archive
+// archive name index (open, lookups) on real or generated archives.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "archive.h"
+#include "unicode.h"
+
+// What the updater used to do: keep the low byte of every code unit
+static size_t naiveToAscii(char* dst, const u16* src, const size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		dst[i] = src[i] % 0xff;
+	}
+	return len;
+}
+
+static void benchTranscoder(const size_t count, const int rounds) {
+	// Mostly ASCII paths like the ones in release archives, with a few non-ASCII ones
+	std::vector<std::u16string> names;
+	size_t units = 0;
+	for (size_t i = 0; i < count; ++i) {
+		std::string name = "luma/sysmodules/module" + std::to_string(i) + ".cxi";
+		std::u16string name16(name.begin(), name.end());
+		if (i % 16 == 0) {
+			name16 += u"-é中\U0001F600";
+		}
+		units += name16.length();
+		names.push_back(name16);
+	}
+
+	std::vector<char> out(UTF8_MAX_SIZE(units));
+	size_t bytes = 0;
+
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		bytes = 0;
+		for (const std::u16string& name : names) {
+			bytes += utf16ToUtf8(out.data() + bytes, (const u16*)name.data(), name.length());
+		}
+	}
+	const double fastMs = elapsedMs(start) / rounds;
+
+	start = Clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		size_t used = 0;
+		for (const std::u16string& name : names) {
+			used += naiveToAscii(out.data() + used, (const u16*)name.data(), name.length());
+		}
+	}
+	const double naiveMs = elapsedMs(start) / rounds;
+
+	std::printf("transcode %zu names (%zu units -> %zu bytes):\n", count, units, bytes);
+	std::printf("  utf16ToUtf8     %8.3f ms  %7.1f ns/name\n", fastMs, fastMs * 1e6 / count);
+	std::printf("  per-unit %%0xff  %8.3f ms  %7.1f ns/name (lossy)\n", naiveMs, naiveMs * 1e6 / count);
+}
+
+static int benchArchive(const char* path, const int rounds) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::fprintf(stderr, "Could not read %s\n", path);
+		return 1;
+	}
+	std::vector<u8> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	try {
+		double openMs = 0, lookupMs = 0;
+		size_t count = 0, lookups = 0;
+		for (int r = 0; r < rounds; ++r) {
+			Clock::time_point start = Clock::now();
+			std::unique_ptr<Archive> archive = Archive::open(data.data(), data.size());
+			openMs += elapsedMs(start);
+
+			// Zip lookups are a linear scan, so only a sample of entries is looked up
+			std::vector<ArchiveEntry> entries = archive->entries();
+			count = entries.size();
+			const size_t step = std::max((size_t)1, count / 1000);
+			lookups = 0;
+			start = Clock::now();
+			for (size_t i = 0; i < count; i += step, ++lookups) {
+				if (!entries[i].isDir && !archive->contains(entries[i].name)) {
+					std::fprintf(stderr, "%s: lookup failed for %s\n", path, entries[i].name.c_str());
+					return 1;
+				}
+			}
+			lookupMs += elapsedMs(start);
+		}
+		std::printf("%s: %zu entries\n", path, count);
+		std::printf("  open + index    %8.3f ms\n", openMs / rounds);
+		std::printf("  %5zu lookups   %8.3f ms  %7.1f ns/lookup\n", lookups, lookupMs / rounds, lookups > 0 ? lookupMs * 1e6 / rounds / lookups : 0.0);
+	} catch (const std::runtime_error& e) {
+		std::fprintf(stderr, "%s: %s\n", path, e.what());
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const int rounds = 20;
+	benchTranscoder(5000, rounds);
+	for (int i = 1; i < argc; ++i) {
+		if (benchArchive(argv[i], rounds) != 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
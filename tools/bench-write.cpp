@@ -0,0 +1,62 @@
+// lumaupdate-bench-write: times the SD writer (temp file, chunked writes, flush, size check,
+// rename) with several chunk sizes against a plain ofstream write. Point it at a directory
+// on the filesystem to test, eg. a mounted FAT image or an SD card reader.
+
+#include "libs.h"
+
+#include <unistd.h>
+
+#include "sdwriter.h"
+#include "tools.h"
+
+// What install paths used to do: one unchecked write, no flush
+static void plainWrite(const std::string& path, const std::vector<u8>& data) {
+	std::ofstream file(path, std::ofstream::binary);
+	file.write((const char*)data.data(), data.size());
+	file.close();
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::fprintf(stderr, "Usage: %s <directory> [size in KiB, default 1024] [rounds, default 5]\n", argv[0]);
+		return 2;
+	}
+	if (chdir(argv[1]) != 0) {
+		std::fprintf(stderr, "Cannot enter %s\n", argv[1]);
+		return 1;
+	}
+	const size_t size = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1024) * 1024;
+	const int rounds = argc > 3 ? std::atoi(argv[3]) : 5;
+
+	std::vector<u8> data(size);
+	for (size_t i = 0; i < size; ++i) {
+		data[i] = (u8)(i * 2654435761u >> 24);
+	}
+
+	const std::string path = "lumaupdate-bench.bin";
+	std::printf("%zu KiB file, %d rounds, in %s\n", size / 1024, rounds, argv[1]);
+
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		plainWrite(path, data);
+		sync();
+	}
+	double ms = elapsedMs(start) / rounds;
+	std::printf("  ofstream + sync      %8.2f ms  %7.2f MB/s\n", ms, size / (ms * 1000.0));
+
+	static const u32 chunkSizes[] = { 4096, 16384, 32768, 65536, 131072, 262144, 1048576 };
+	for (const u32 chunkSize : chunkSizes) {
+		SdWriter sd(chunkSize);
+		bool ok = true;
+		start = Clock::now();
+		for (int r = 0; r < rounds && ok; ++r) {
+			ok = sd.replace(path, data.data(), data.size(), path + ".bak");
+		}
+		ms = elapsedMs(start) / rounds;
+		std::printf("  SdWriter %4u KiB    %8.2f ms  %7.2f MB/s%s\n", sd.chunkSize() / 1024, ms, size / (ms * 1000.0), ok ? "" : "  FAILED");
+	}
+
+	std::remove(path.c_str());
+	std::remove((path + ".bak").c_str());
+	return 0;
+}
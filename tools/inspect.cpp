@@ -0,0 +1,104 @@
+// lumaupdate-inspect: dumps the layout of a release archive and times the
+// extraction of every entry, using the same archive code as the updater.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "archive.h"
+
+static void usage(const char* self) {
+	std::fprintf(stderr, "Usage: %s [-l] <archive.7z|archive.zip>\n", self);
+	std::fprintf(stderr, "  -l  only list blocks and entries, don't decode anything\n");
+}
+
+int main(int argc, char* argv[]) {
+	bool listOnly = false;
+	const char* path = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "-l") == 0) {
+			listOnly = true;
+		} else if (path == nullptr && argv[i][0] != '-') {
+			path = argv[i];
+		} else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (path == nullptr) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	std::vector<u8> data;
+	if (!readFile(path, &data)) {
+		std::fprintf(stderr, "Could not read %s\n", path);
+		return 1;
+	}
+
+	try {
+		std::unique_ptr<Archive> archive = Archive::open(data.data(), data.size());
+		std::vector<ArchiveBlock> blocks = archive->blocks();
+		std::vector<ArchiveEntry> entries = archive->entries();
+
+		std::printf("%s: %zu bytes, %zu blocks, %zu entries\n\n", path, data.size(), blocks.size(), entries.size());
+
+		std::printf("%5s  %-24s %10s %10s %6s %6s\n", "block", "coders", "packed", "unpacked", "ratio", "files");
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			const ArchiveBlock& b = blocks[i];
+			double ratio = b.unpackedSize > 0 ? 100.0 * b.packedSize / b.unpackedSize : 0.0;
+			std::printf("%5zu  %-24s %10zu %10zu %5.1f%% %6lu\n", i, b.coders.c_str(), b.packedSize, b.unpackedSize, ratio, (unsigned long)b.fileCount);
+		}
+
+		std::printf("\n%5s %10s", "block", "size");
+		if (!listOnly) {
+			std::printf(" %9s %9s %10s", "ms", "MB/s", "peak");
+		}
+		std::printf("  name\n");
+
+		size_t peak = 0;
+		u32 lastBlock = ArchiveEntry::NoBlock;
+		for (const ArchiveEntry& e : entries) {
+			if (e.block == ArchiveEntry::NoBlock) {
+				std::printf("%5s %10s", "-", e.isDir ? "<dir>" : "0");
+			} else {
+				std::printf("%5lu %10zu", (unsigned long)e.block, e.size);
+			}
+
+			if (!listOnly) {
+				if (e.isDir) {
+					std::printf(" %9s %9s %10s", "", "", "");
+				} else {
+					const Clock::time_point start = Clock::now();
+					ArchiveBuffer file = archive->extractFile(e.name);
+					double ms = elapsedMs(start);
+
+					// Throughput over what was actually decoded: the first entry of a 7z block
+					// pays for the whole block, the following ones are only checksummed
+					size_t decoded = e.size;
+					if (e.block != ArchiveEntry::NoBlock && e.block != lastBlock) {
+						decoded = blocks[e.block].unpackedSize;
+					}
+					lastBlock = e.block;
+					double mbs = ms > 0 ? (decoded / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0;
+					peak = std::max(peak, archive->lastPeakMemory());
+					std::printf(" %9.3f %9.2f %10zu", ms, mbs, archive->lastPeakMemory());
+				}
+			}
+
+			std::printf("  %s\n", e.name.c_str());
+		}
+
+		if (!listOnly) {
+			std::printf("\nPeak memory for a single extraction: %zu bytes\n", peak);
+			if (archive->peakMemory() > 0) {
+				std::printf("Peak decoder memory held at once: %zu bytes (%lu allocs)\n", archive->peakMemory(), (unsigned long)archive->allocCount());
+			}
+		}
+	} catch (const std::runtime_error& e) {
+		std::fprintf(stderr, "%s: %s\n", path, e.what());
+		return 1;
+	}
+
+	return 0;
+}
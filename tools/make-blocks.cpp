@@ -0,0 +1,72 @@
+// lumaupdate-blocks: writes the block checksum file of a payload (see blocksync.h), to
+// publish next to it on a sync mirror. Given the previous payload too, shows what a
+// console that has it installed would download.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "blocksync.h"
+
+int main(int argc, char* argv[]) {
+	if (argc < 2 || argc > 4) {
+		std::fprintf(stderr, "Usage: %s <payload> [block size] [old payload]\n", argv[0]);
+		std::fprintf(stderr, "Writes <payload>%s, blocks are %u bytes by default\n", BLOCKSYNC_SUFFIX, BLOCKSYNC_DEFAULT_BLOCK);
+		return 2;
+	}
+
+	std::vector<u8> payload;
+	if (!readFile(argv[1], &payload)) {
+		std::fprintf(stderr, "Could not read %s\n", argv[1]);
+		return 1;
+	}
+	const long blockSize = argc > 2 ? std::strtol(argv[2], nullptr, 10) : BLOCKSYNC_DEFAULT_BLOCK;
+	if (blockSize < 16 || blockSize > 1024 * 1024) {
+		std::fprintf(stderr, "Block size must be between 16 bytes and 1 MiB\n");
+		return 2;
+	}
+
+	const std::vector<u8> sumsFile = blockSyncMake(payload.data(), payload.size(), blockSize);
+	const std::string sumsPath = std::string(argv[1]) + BLOCKSYNC_SUFFIX;
+	std::ofstream out(sumsPath, std::ios::binary);
+	out.write((const char*)sumsFile.data(), sumsFile.size());
+	out.close();
+	if (!out) {
+		std::fprintf(stderr, "Could not write %s\n", sumsPath.c_str());
+		return 1;
+	}
+
+	BlockSums sums;
+	if (!blockSyncParse(sumsFile.data(), sumsFile.size(), &sums)) {
+		std::fprintf(stderr, "Checksum file doesn't parse, this is a bug\n");
+		return 1;
+	}
+	std::printf("%s: %u blocks of %ld bytes, %zu bytes\n", sumsPath.c_str(), sums.blockCount(), blockSize, sumsFile.size());
+	if (argc < 4) {
+		return 0;
+	}
+
+	std::vector<u8> old;
+	if (!readFile(argv[3], &old)) {
+		std::fprintf(stderr, "Could not read %s\n", argv[3]);
+		return 1;
+	}
+
+	// Same steps as the updater: find blocks in the old payload, then fetch the rest from the new one
+	std::vector<u8> target(payload.size());
+	std::vector<bool> found;
+	const u32 matched = blockSyncMatch(sums, old.data(), old.size(), target.data(), &found);
+	u32 fetched = 0;
+	const std::vector<std::pair<u32, u32>> ranges = blockSyncRanges(sums, found);
+	for (const auto& range : ranges) {
+		std::memcpy(&target[range.first], &payload[range.first], range.second);
+		fetched += range.second;
+	}
+	if (target != payload) {
+		std::fprintf(stderr, "Synced payload differs, this is a bug\n");
+		return 1;
+	}
+	std::printf("From %s: %u of %u blocks found, %u bytes in %zu range(s) to download (%.2f%%, plus %zu bytes of checksums)\n",
+		argv[3], matched, sums.blockCount(), fetched, ranges.size(), 100.0 * fetched / std::max<size_t>(payload.size(), 1), sumsFile.size());
+	return 0;
+}
\ No newline at end of file
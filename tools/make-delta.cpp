@@ -0,0 +1,182 @@
+// lumaupdate-delta: makes a patch from one payload to another (see deltaupdate.h for the
+// format), checks it applies, and prints the line to add to the delta manifest.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "bytes.h"
+#include "deltaupdate.h"
+#include "digest.h"
+
+// Bytes hashed to find match candidates, and shortest copy worth its operation
+#define KEY_SIZE     8
+#define MIN_MATCH    12
+#define MIN_RUN      16
+#define HASH_BITS    18
+#define CHAIN_LIMIT  64
+
+static u32 keyHash(const u8* data) {
+	u64 key;
+	std::memcpy(&key, data, sizeof(key));
+	return (u32)((key * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+}
+
+static void putVarint(std::vector<u8>& out, u64 value) {
+	while (value >= 0x80) {
+		out.push_back((u8)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((u8)value);
+}
+
+static void putSHA256(std::vector<u8>& out, const std::vector<u8>& data) {
+	u8 hash[32];
+	digestSHA256(data.data(), data.size(), hash);
+	out.insert(out.end(), hash, hash + sizeof(hash));
+}
+
+struct Encoder {
+	std::vector<u8>& out;
+	u64 copyEnd;
+
+	Encoder(std::vector<u8>& out) : out(out), copyEnd(0) {}
+
+	// Literals go out as they are, except long runs of one byte
+	void literal(const u8* data, size_t size) {
+		size_t start = 0;
+		for (size_t i = 0; i < size;) {
+			size_t run = 1;
+			while (i + run < size && data[i + run] == data[i]) {
+				run++;
+			}
+			if (run < MIN_RUN) {
+				i += run;
+				continue;
+			}
+			add(data + start, i - start);
+			putVarint(out, (u64)run << 2 | DELTA_OP_RUN);
+			out.push_back(data[i]);
+			i += run;
+			start = i;
+		}
+		add(data + start, size - start);
+	}
+
+	void add(const u8* data, const size_t size) {
+		if (size == 0) {
+			return;
+		}
+		putVarint(out, (u64)size << 2 | DELTA_OP_ADD);
+		out.insert(out.end(), data, data + size);
+	}
+
+	void copy(const u64 offset, const u64 length) {
+		const s64 distance = (s64)offset - (s64)copyEnd;
+		putVarint(out, length << 2 | DELTA_OP_COPY);
+		putVarint(out, ((u64)distance << 1) ^ (u64)(distance >> 63));
+		copyEnd = offset + length;
+	}
+};
+
+static std::vector<u8> makeDelta(const std::vector<u8>& source, const std::vector<u8>& target) {
+	std::vector<u8> patch(DELTA_MAGIC, DELTA_MAGIC + 4);
+	putU32LE(patch, source.size());
+	putU32LE(patch, target.size());
+	putSHA256(patch, source);
+	putSHA256(patch, target);
+
+	// Chained hash table of every source position, newest first
+	std::vector<s32> head(1 << HASH_BITS, -1);
+	std::vector<s32> chain(source.size(), -1);
+	for (size_t i = 0; i + KEY_SIZE <= source.size(); i++) {
+		const u32 hash = keyHash(&source[i]);
+		chain[i] = head[hash];
+		head[hash] = (s32)i;
+	}
+
+	auto matchLength = [&source, &target](const size_t from, const size_t to) {
+		size_t length = 0;
+		while (from + length < source.size() && to + length < target.size() && source[from + length] == target[to + length]) {
+			length++;
+		}
+		return length;
+	};
+
+	Encoder encoder(patch);
+	size_t literalStart = 0;
+	for (size_t i = 0; i + KEY_SIZE <= target.size();) {
+		// Where the source would continue if the bytes since the last copy were just changed
+		size_t bestOffset = encoder.copyEnd + (i - literalStart);
+		size_t bestLength = bestOffset < source.size() ? matchLength(bestOffset, i) : 0;
+
+		u32 steps = 0;
+		for (s32 candidate = head[keyHash(&target[i])]; candidate >= 0 && steps < CHAIN_LIMIT; candidate = chain[candidate], steps++) {
+			const size_t length = matchLength(candidate, i);
+			if (length > bestLength) {
+				bestLength = length;
+				bestOffset = candidate;
+			}
+		}
+
+		if (bestLength < MIN_MATCH) {
+			i++;
+			continue;
+		}
+
+		// Grow the match backwards into the pending literal
+		while (i > literalStart && bestOffset > 0 && source[bestOffset - 1] == target[i - 1]) {
+			i--;
+			bestOffset--;
+			bestLength++;
+		}
+		encoder.literal(&target[literalStart], i - literalStart);
+		encoder.copy(bestOffset, bestLength);
+		i += bestLength;
+		literalStart = i;
+	}
+	encoder.literal(target.data() + literalStart, target.size() - literalStart);
+	return patch;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 4 && argc != 7) {
+		std::fprintf(stderr, "Usage: %s <old payload> <new payload> <patch> [<release> <payload name> <patch url>]\n", argv[0]);
+		std::fprintf(stderr, "With the last three, prints the matching delta manifest line\n");
+		return 2;
+	}
+
+	std::vector<u8> source, target;
+	if (!readFile(argv[1], &source) || !readFile(argv[2], &target)) {
+		std::fprintf(stderr, "Could not read payloads\n");
+		return 1;
+	}
+
+	const Clock::time_point start = Clock::now();
+	const std::vector<u8> patch = makeDelta(source, target);
+	const double ms = elapsedMs(start);
+
+	// Check the patch the same way the updater will use it
+	ArchiveBuffer result;
+	if (!deltaApply(source.data(), source.size(), patch.data(), patch.size(), &result) ||
+		result.size != target.size() || std::memcmp(result.data, target.data(), target.size()) != 0) {
+		std::fprintf(stderr, "Patch doesn't apply, this is a bug\n");
+		return 1;
+	}
+
+	std::ofstream file(argv[3], std::ios::binary);
+	file.write((const char*)patch.data(), patch.size());
+	file.close();
+	if (!file) {
+		std::fprintf(stderr, "Could not write %s\n", argv[3]);
+		return 1;
+	}
+	std::fprintf(stderr, "%s: %zu bytes (%.2f%% of %zu) in %.1f ms\n", argv[3], patch.size(), 100.0 * patch.size() / std::max<size_t>(target.size(), 1), target.size(), ms);
+
+	if (argc == 7) {
+		const std::string from = digestHex(patch.data() + 12, 32);
+		const std::string to = digestHex(patch.data() + 12 + 32, 32);
+		std::printf("%s %s %s %s %s\n", argv[4], argv[5], from.c_str(), to.c_str(), argv[6]);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+// lumaupdate-manifest: turns a GitHub API release (repos/.../releases/latest, saved with
+// curl or similar) into the release manifest a mirror serves (see manifest.h).
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include "manifest.h"
+
+int main(int argc, char* argv[]) {
+	if (argc < 3 || argc > 5) {
+		std::fprintf(stderr, "Usage: %s <release.json> <manifest> [delta manifest url] [sync mirror url]\n", argv[0]);
+		std::fprintf(stderr, "Use - to skip the delta manifest url\n");
+		return 2;
+	}
+
+	std::string json;
+	if (!readFile(argv[1], &json)) {
+		std::fprintf(stderr, "Could not read %s\n", argv[1]);
+		return 1;
+	}
+
+	ReleaseInfo release;
+	if (!manifestParseGitHub(json.data(), json.size(), &release) || release.versions.empty()) {
+		std::fprintf(stderr, "No release found in %s\n", argv[1]);
+		return 1;
+	}
+	if (argc > 3 && std::string(argv[3]) != "-") {
+		release.deltaManifest = argv[3];
+	}
+	if (argc > 4) {
+		release.syncMirror = argv[4];
+	}
+
+	// The updater must read back exactly what was written, versions in the same order
+	const std::string manifest = manifestWrite(release);
+	ReleaseInfo check;
+	const bool parsed = manifestParse((const u8*)manifest.data(), manifest.size(), &check);
+	bool same = parsed && check.name == release.name && check.description == release.description &&
+		check.versions.size() == release.versions.size() &&
+		check.deltaManifest == release.deltaManifest && check.syncMirror == release.syncMirror;
+	for (size_t i = 0; same && i < release.versions.size(); ++i) {
+		const ReleaseVer& a = check.versions[i];
+		const ReleaseVer& b = release.versions[i];
+		same = a.filename == b.filename && a.url == b.url && a.fileSize == b.fileSize && a.digest == b.digest;
+	}
+	if (!same) {
+		std::fprintf(stderr, "Manifest doesn't parse back, is there a space in a file name or URL?\n");
+		return 1;
+	}
+
+	std::ofstream out(argv[2], std::ios::binary);
+	out.write(manifest.data(), manifest.size());
+	out.close();
+	if (!out) {
+		std::fprintf(stderr, "Could not write %s\n", argv[2]);
+		return 1;
+	}
+	std::fprintf(stderr, "%s: %zu bytes (%zu bytes of JSON), %zu version(s)\n", argv[2], manifest.size(), json.size(), release.versions.size());
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+// lumaupdate-version: detects the Luma3DS version of payload files, using the same
+// search as the updater does on the current payload and its backup.
+
+#include "libs.h"
+
+#include "tools.h"
+
+#include <cstdarg>
+
+#include "version.h"
+
+// version.cpp logs through the updater console
+void logPrintf(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	std::vfprintf(stderr, format, args);
+	va_end(args);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::fprintf(stderr, "Usage: %s <payload.bin>...\n", argv[0]);
+		return 2;
+	}
+
+	int missing = 0;
+	for (int i = 1; i < argc; ++i) {
+		const Clock::time_point start = Clock::now();
+		const LumaVersion version = versionMemsearch(argv[i]);
+		const double us = elapsedUs(start);
+
+		if (version.isValid()) {
+			std::printf("%s: %s (%.1f us)\n", argv[i], version.toString().c_str(), us);
+		} else {
+			std::printf("%s: no version found (%.1f us)\n", argv[i], us);
+			missing++;
+		}
+	}
+	return missing == 0 ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Helpers shared by the host tools
+
+#include "libs.h"
+
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+/*! \brief Milliseconds since `start` */
+inline double elapsedMs(const Clock::time_point& start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/*! \brief Microseconds since `start` */
+inline double elapsedUs(const Clock::time_point& start) {
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/*! \brief Reads a whole file
+ *
+ * \param path File to read
+ * \param data Buffer (vector or string) to fill
+ *
+ * \return true if the whole file was read, false otherwise
+ */
+template <typename Buffer>
+bool readFile(const char* path, Buffer* data) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+	data->resize((size_t)file.tellg());
+	if (data->empty()) {
+		return true;
+	}
+	file.seekg(0, std::ios::beg);
+	file.read((char*)&(*data)[0], data->size());
+	return (bool)file;
+}
\ No newline at end of file